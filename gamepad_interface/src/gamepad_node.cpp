@@ -1,4 +1,5 @@
 #include <rclcpp/rclcpp.hpp>
+#include <rclcpp_components/register_node_macro.hpp>
 #include <gamepad_interface/mapper.hpp>
 
 using namespace std;
@@ -6,7 +7,8 @@ using namespace std;
 class GamepadNode : public rclcpp::Node
 {
 public:
-  GamepadNode() : Node("gamepad_node"), driver_(declare_parameter<string>("device_path", DualSenseDriver::auto_detect())), mapper_(4.0f)
+  explicit GamepadNode(const rclcpp::NodeOptions &options = rclcpp::NodeOptions())
+      : Node("gamepad_node", options), driver_(declare_parameter<string>("device_path", DualSenseDriver::auto_detect())), mapper_(4.0f)
   {
     base_cmd_pub_ = create_publisher<robot_interfaces::msg::BaseCmd>("base_cmd", 10);
     timer_ = create_wall_timer(chrono::milliseconds(2), bind(&GamepadNode::loop, this));
@@ -21,8 +23,9 @@ private:
 
     MapperOutput mo = mapper_.update(st);
 
+    // unique_ptr: trong cùng container (use_intra_process_comms) uart_node nhận thẳng, không serialize
     if (mo.has_base_cmd)
-      base_cmd_pub_->publish(mo.base_cmd);
+      base_cmd_pub_->publish(std::make_unique<robot_interfaces::msg::BaseCmd>(mo.base_cmd));
 
     if (mo.has_request_mcu)
     {
@@ -106,10 +109,5 @@ private:
   rclcpp::Client<robot_interfaces::srv::RequestAction>::SharedPtr req_act_cli_;
   rclcpp::Client<robot_interfaces::srv::RequestOdrive>::SharedPtr req_odrv_cli_;
 };
-int main(int argc, char **argv)
-{
-  rclcpp::init(argc, argv);
-  rclcpp::spin(std::make_shared<GamepadNode>());
-  rclcpp::shutdown();
-  return 0;
-}
+
+RCLCPP_COMPONENTS_REGISTER_NODE(GamepadNode)
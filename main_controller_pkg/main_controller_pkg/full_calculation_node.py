@@ -1,8 +1,9 @@
 import rclpy
 import math
+from rclpy.action import ActionClient
 from rclpy.node import Node
 from robot_interfaces.srv import RequestCalculation
-from robot_interfaces.srv import Control
+from robot_interfaces.action import Control
 #!/usr/bin/env python3
 
 class FullCalculationNode(Node):
@@ -16,8 +17,8 @@ class FullCalculationNode(Node):
             self.request_calculation_callback
         )
 
-        # Create a client for the 'control' service
-        self.control_client = self.create_client(Control, 'control')
+        # Create a client for the 'control' action
+        self.control_client = ActionClient(self, Control, 'control')
 
         self.get_logger().info('Full calculation node is ready.')
 
@@ -39,18 +40,22 @@ class FullCalculationNode(Node):
         return response
 
     def send_control_request(self, action, velocity):
-        if not self.control_client.wait_for_service(timeout_sec=1.0):
-            self.get_logger().error('Control service not available, exiting...')
+        if not self.control_client.wait_for_server(timeout_sec=1.0):
+            self.get_logger().error('Control action server not available')
             return
-        request = Control.Request()
-        request.action = action
-        request.velocity = velocity
-        future = self.control_client.call_async(request)
-        rclpy.spin_until_future_complete(self, future, timeout_sec=0.5)
-        if future.result() is not None:
-            self.get_logger().info('Feedback %d' % action)
-        else:
-            self.get_logger().warn('No response from control service: %r' % future.exception())
+        goal = Control.Goal()
+        goal.action = action
+        goal.velocity = velocity
+        future = self.control_client.send_goal_async(goal)
+        future.add_done_callback(self.control_goal_response_callback)
+
+    def control_goal_response_callback(self, future):
+        goal_handle = future.result()
+        if goal_handle is None or not goal_handle.accepted:
+            self.get_logger().warn('Control goal rejected')
+            return
+        goal_handle.get_result_async().add_done_callback(
+            lambda f: self.get_logger().info('Shot finished: %s' % f.result().result.message))
     # Calculate RPS from linear velocity and pulley diameter
     def calculate_rps(self, linear_velocity):
         """
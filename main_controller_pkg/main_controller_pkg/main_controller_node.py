@@ -1,7 +1,8 @@
 import rclpy
+from rclpy.action import ActionClient
 from rclpy.node import Node
 from robot_interfaces.msg import IMU
-from robot_interfaces.srv import Control
+from robot_interfaces.action import Control
 from robot_interfaces.srv import RequestCalculation
 from robot_interfaces.srv import RotateBase
 from robot_interfaces.srv import RequestAction
@@ -16,7 +17,7 @@ class MainControllerNode(Node):
         self.base_mode = 0
 
         self.action_srv = self.create_service(RequestAction, 'request_action', self.request_action_callback)
-        self.control_client = self.create_client(Control, 'control')
+        self.control_client = ActionClient(self, Control, 'control')
         self.request_calculation_client = self.create_client(RequestCalculation, 'request_calculation')
         self.rotate_base_client = self.create_client(RotateBase, 'rotate_base')
         self.imu_subscriber = self.create_subscription(
@@ -50,19 +51,33 @@ class MainControllerNode(Node):
         response.success = success  # or False based on your logic
         return response
 
-    def send_control_request(self, action, velocity = 0):
-        if not self.control_client.wait_for_service(timeout_sec=1.0):
-            self.get_logger().error('Control service not available, exiting...')
+    def send_control_request(self, action, velocity = 0, on_done = None):
+        """Send a /control goal; on_done(success, message) runs when the sequence really ends."""
+        if not self.control_client.wait_for_server(timeout_sec=1.0):
+            self.get_logger().error('Control action server not available')
             return
-        request = Control.Request()
-        request.action = action
-        request.velocity = velocity
-        future = self.control_client.call_async(request)
-        rclpy.spin_until_future_complete(self, future, timeout_sec=0.5)
-        if future.result() is not None:
-            self.get_logger().info('Feedback %d' % action)
-        else:
-            self.get_logger().warn('No response from control service: %r' % future.exception())
+        goal = Control.Goal()
+        goal.action = action
+        goal.velocity = velocity
+        future = self.control_client.send_goal_async(goal, feedback_callback=self.control_feedback_callback)
+        future.add_done_callback(lambda f: self.control_goal_response_callback(f, action, on_done))
+
+    def control_feedback_callback(self, feedback_msg):
+        self.get_logger().debug('Control phase: %s' % feedback_msg.feedback.phase)
+
+    def control_goal_response_callback(self, future, action, on_done):
+        goal_handle = future.result()
+        if goal_handle is None or not goal_handle.accepted:
+            self.get_logger().warn('Control goal %d rejected' % action)
+            return
+        goal_handle.get_result_async().add_done_callback(
+            lambda f: self.control_result_callback(f, action, on_done))
+
+    def control_result_callback(self, future, action, on_done):
+        result = future.result().result
+        self.get_logger().info('Control %d finished: %s' % (action, result.message))
+        if on_done is not None:
+            on_done(result.success, result.message)
 
     def send_request_calculation(self, distance):
         if not self.request_calculation_client.wait_for_service(timeout_sec=1.0):
@@ -1,13 +1,17 @@
 #pragma once
 
 #include <rclcpp/rclcpp.hpp>
+#include <array>
+#include <atomic>
 #include <vector>
-#include <queue>
 #include <mutex>
 #include <termios.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <cstring>
+#include "mcu_interface/mcu_protocol.hpp"
+#include "mcu_interface/uart_frame_ring.hpp"
+#include "odrive_interface/rt_thread.hpp"
 #include "robot_interfaces/msg/imu.hpp"
 #include "robot_interfaces/msg/base_cmd.hpp"
 #include "robot_interfaces/srv/rotate_base.hpp"
@@ -34,23 +38,32 @@
 #define FRAME_180_ROTATE      {0x99, 0x02, 0x11, 0xB1, 0x05, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}
 
 /**
- * @brief UARTNode giao tiếp UART với vi điều khiển qua USB-TTL, nhận và gửi dữ liệu định dạng 12 byte.
+ * @brief UARTNode giao tiếp UART với vi điều khiển qua USB-TTL: frame 12 byte cũ hoặc giao thức v2 (mcu_protocol.hpp).
  */
 class UARTNode : public rclcpp::Node {
 public:
-    UARTNode(); ///< Hàm khởi tạo node ROS2
+    explicit UARTNode(const rclcpp::NodeOptions& options = rclcpp::NodeOptions()); ///< Hàm khởi tạo node ROS2 (standalone hoặc component)
+    ~UARTNode() override; ///< Dừng luồng đọc UART và đóng cổng
 
 private:
     // ==== Cổng UART ====
     void configure_port(int fd, speed_t baudrate); ///< Cấu hình tốc độ truyền UART
+    static speed_t baud_to_speed(int baud); ///< 115200 → B115200, B0 nếu không hỗ trợ
 
     // ==== Mã hóa dữ liệu ====
     void float32_to_little_endian_8byte(float value, uint8_t out[8]); ///< Chuyển float32 thành 8 byte little endian
 
     // ==== Hàng đợi gửi UART ====
-    void enqueue_uart_packet(uint8_t cmd, const uint8_t* data8);
-    void Senqueue_uart_packet(uint8_t cmd, const uint8_t* data8); ///< Đóng gói frame UART và đưa vào hàng đợi
-    void process_uart_queue(); ///< Gửi từng frame từ hàng đợi qua UART
+    static UartFrame make_uart_frame(uint8_t cmd, const uint8_t* data8); ///< Đóng gói frame 12 byte, tính checksum tại chỗ
+    bool Senqueue_uart_packet(uint8_t cmd, const uint8_t* data8); ///< Đưa frame service vào Suart_queue_, false nếu đầy
+    void notify_uart_tx(); ///< Đánh thức luồng ghi qua eventfd sau khi đưa frame vào hàng đợi
+    size_t next_uart_message(uint8_t* out); ///< Mã hóa message kế tiếp (SS > S > base_cmd) theo giao thức hiện tại, 0 nếu không có
+    void uart_write_loop(); ///< Luồng ghi: bắt tay v2, chờ eventfd, gửi message cách nhau đúng thời gian trên dây
+    void write_uart_bytes(const uint8_t* data, size_t len); ///< Ghi ra UART và log
+
+    // ==== Real-time ====
+    void configure_realtime(); ///< Đọc tham số uart_rt_priority/uart_cpus/rt_lock_memory, gọi mlockall
+    void apply_thread_rt(std::thread& thread, const char* name); ///< Áp uart_rt_ (applyRtConfig) cho một luồng I/O, lỗi chỉ log
 
     // ==== Gửi lệnh khởi tạo ====
     void send_initialization_commands(); ///< Gửi các gói cấu hình ban đầu đến MCU
@@ -65,19 +78,31 @@ private:
                                      std::shared_ptr<robot_interfaces::srv::RequestMcu::Response> response); ///< Xử lý lệnh điều khiển cơ sở từ service
 
     // ==== Nhận dữ liệu UART ====
+    static constexpr size_t RX_FRAME_SIZE = 12; ///< Frame MCU → PC: 0x99, type, 0x01, checksum, 8 byte data
     float convert_to_angle(uint8_t low, uint8_t high); ///< Giải mã góc từ 2 byte
-    void uart_read_loop(); ///< Đọc UART, ghép frame và publish topic IMU
+    void uart_read_loop(); ///< poll + đọc khối vào rx_buf_, publish topic IMU
+    size_t parse_rx(const uint8_t* data, size_t len); ///< Chọn parser theo giao thức, trả về số byte đã dùng
+    size_t parse_rx_frames(const uint8_t* data, size_t len); ///< Giao thức cũ: tách mọi frame đủ 12 byte
+    size_t parse_rx_v2(const uint8_t* data, size_t len); ///< Giao thức v2: tách mọi khung COBS kết thúc bằng 0x00
+    bool find_hello_ack(const uint8_t* data, size_t len); ///< Tìm HELLO_ACK đúng phiên bản trong lúc bắt tay
+    void handle_v2_message(const mcu_proto::Message& msg); ///< Xử lý một message v2 đã kiểm CRC
 
     // ==== Biến thành viên ====
-    int uart_fd_;
-    std::vector<uint8_t> buffer_;
-    bool syncing_ = false;
-    std::mutex uart_mutex_;
-    std::mutex uart_queue_mutex_;
-    std::queue<std::vector<uint8_t>> uart_queue_; // thang nay se luu gia tri cua tu topic base_cmd
-    std::queue<std::vector<uint8_t>> Suart_queue_; // thang nay se luu gia tri cua 2 service kia va thang nay se duoc uu tien hon do no gui it
-    std::queue<std::vector<uint8_t>> SSuart_queue_;  
+    int uart_fd_ = -1;
+    std::atomic<bool> running_{true}; ///< false khi node bị hủy, luồng đọc thoát
+    std::array<uint8_t, 512> rx_buf_{}; ///< Buffer đọc UART, chỉ luồng đọc dùng
+    size_t rx_len_ = 0; ///< Số byte chưa xử lý trong rx_buf_ (một frame dở dang sau mỗi lần parse)
+    enum class LinkProtocol : uint8_t { PROBING, LEGACY, V2 };
+    std::atomic<LinkProtocol> link_protocol_{LinkProtocol::LEGACY}; ///< PROBING: đang chờ HELLO_ACK, gửi frame cũ
+    std::chrono::milliseconds handshake_timeout_{200};
+    // base_cmd: mỗi lệnh (vận tốc 0x0E, góc 0x0F, xoay 0x10) chỉ giữ giá trị mới nhất, gửi luân phiên
+    static constexpr uint8_t BASE_CMD_IDS[3] = {0x0E, 0x0F, 0x10};
+    std::array<UartLatestSlot, 3> base_cmd_slots_;
+    size_t base_cmd_next_ = 0; ///< Ô base_cmd được xét đầu tiên ở lần gửi kế tiếp (chỉ luồng ghi)
+    UartFrameRing<8> Suart_queue_; // thang nay se luu gia tri cua 2 service kia va thang nay se duoc uu tien hon do no gui it
+    UartFrameRing<8> SSuart_queue_; // request_mcu, uu tien cao nhat
     int mode_state; // Mode state cho service base_control
+    RtThreadConfig uart_rt_; ///< uart_rt_priority/uart_cpus, prefault_stack khi đã mlockall; dùng chung cho luồng đọc và ghi
 
     // ==== ROS2 ====
     rclcpp::Publisher<robot_interfaces::msg::IMU>::SharedPtr pub_imu_;
@@ -86,7 +111,9 @@ private:
     rclcpp::Service<robot_interfaces::srv::PushBall>::SharedPtr service_push_ball_;
     rclcpp::Subscription<robot_interfaces::msg::BaseCmd>::SharedPtr sub_base_cmd_;
     rclcpp::TimerBase::SharedPtr timer_;
-    rclcpp::TimerBase::SharedPtr uart_tx_timer_;
     std::thread uart_read_thread_;
+    std::thread uart_write_thread_;
+    int tx_event_fd_ = -1; ///< eventfd báo luồng ghi có frame mới
+    std::chrono::nanoseconds byte_wire_time_{0}; ///< Thời gian một byte trên dây theo uart_baud (8N1)
 
 };
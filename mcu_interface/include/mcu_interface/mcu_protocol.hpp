@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief Giao thức UART v2 PC ↔ MCU: message độ dài thay đổi, đóng khung COBS, CRC-16.
+ *
+ * Trên dây: COBS([type][payload...][crc lo][crc hi]) rồi một byte 0x00 kết thúc khung.
+ * CRC-16/CCITT-FALSE (đa thức 0x1021, khởi tạo 0xFFFF) tính trên type + payload.
+ * Bắt tay: PC gửi HELLO, MCU hỗ trợ v2 trả HELLO_ACK; không có trả lời thì PC dùng frame 12 byte cũ.
+ */
+namespace mcu_proto {
+
+constexpr uint8_t VERSION = 2;
+constexpr size_t MAX_PAYLOAD = 48;
+constexpr size_t MAX_RAW = 1 + MAX_PAYLOAD + 2;            ///< type + payload + CRC
+constexpr size_t MAX_ENCODED = MAX_RAW + MAX_RAW / 254 + 2; ///< + byte mã COBS + byte 0x00
+
+enum MsgType : uint8_t {
+    HELLO = 0x01,     ///< PC → MCU: [version]
+    COMMAND = 0x02,   ///< PC → MCU: [nhóm][lệnh][data...] lệnh 12 byte cũ, bỏ checksum và các byte 0 ở cuối
+    BASE_CMD = 0x03,  ///< PC → MCU: [velocity f32][angle f32][rotate u8], thay 3 frame 0x0E/0x0F/0x10
+    HELLO_ACK = 0x81, ///< MCU → PC: [version]
+    TELEMETRY = 0x82, ///< MCU → PC: [n][n × yaw int16 LE] nhiều mẫu IMU trong một message
+};
+
+/// CRC-16/CCITT-FALSE
+constexpr uint16_t crc16(const uint8_t* data, size_t len, uint16_t crc = 0xFFFF) {
+    for (size_t i = 0; i < len; ++i) {
+        crc ^= static_cast<uint16_t>(data[i] << 8);
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = (crc & 0x8000) ? static_cast<uint16_t>((crc << 1) ^ 0x1021) : static_cast<uint16_t>(crc << 1);
+        }
+    }
+    return crc;
+}
+
+struct Message {
+    uint8_t type = 0;
+    uint8_t payload[MAX_PAYLOAD];
+    size_t len = 0;
+};
+
+/// Mã hóa một message vào out (>= MAX_ENCODED byte), gồm cả byte 0x00 cuối; 0 nếu payload quá dài
+size_t encode(uint8_t type, const uint8_t* payload, size_t len, uint8_t* out);
+
+/// Giải mã một khung COBS (không gồm byte 0x00); false nếu khung hỏng hoặc sai CRC
+bool decode(const uint8_t* frame, size_t len, Message& out);
+
+} // namespace mcu_proto
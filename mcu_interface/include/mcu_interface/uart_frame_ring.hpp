@@ -0,0 +1,113 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+using UartFrame = std::array<uint8_t, 12>; ///< Một frame UART PC → MCU
+
+/**
+ * @brief Hàng đợi vòng MPSC không khóa, kích thước cố định, chứa frame UART 12 byte.
+ *
+ * Nhiều luồng (các service, khởi tạo) gọi push(); chỉ luồng ghi UART gọi pop()/size()/clear().
+ * Mỗi slot có số thứ tự riêng: producer giành chỗ bằng một CAS trên head_, không cấp phát bộ nhớ.
+ */
+template <size_t Capacity>
+class UartFrameRing {
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    UartFrameRing() {
+        for (size_t i = 0; i < Capacity; ++i) slots_[i].seq.store(i, std::memory_order_relaxed);
+    }
+    UartFrameRing(const UartFrameRing&) = delete;
+    UartFrameRing& operator=(const UartFrameRing&) = delete;
+
+    /// Thêm frame; false nếu hàng đợi đầy (frame bị bỏ)
+    bool push(const UartFrame& frame) {
+        size_t pos = head_.load(std::memory_order_relaxed);
+        while (true) {
+            Slot& slot = slots_[pos & MASK];
+            const size_t seq = slot.seq.load(std::memory_order_acquire);
+            const auto diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+            if (diff == 0) {
+                if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    slot.frame = frame;
+                    slot.seq.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = head_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /// Lấy frame cũ nhất (chỉ luồng tiêu thụ); false nếu rỗng
+    bool pop(UartFrame& out) {
+        Slot& slot = slots_[tail_ & MASK];
+        if (slot.seq.load(std::memory_order_acquire) != tail_ + 1) return false;
+        out = slot.frame;
+        slot.seq.store(tail_ + Capacity, std::memory_order_release);
+        ++tail_;
+        return true;
+    }
+
+    /// Số frame đang chờ (gồm cả frame producer đang ghi dở), chỉ luồng tiêu thụ
+    size_t size() const { return head_.load(std::memory_order_relaxed) - tail_; }
+
+    /// Bỏ mọi frame đã sẵn sàng (chỉ luồng tiêu thụ)
+    void clear() {
+        UartFrame frame;
+        while (pop(frame)) {}
+    }
+
+private:
+    static constexpr size_t MASK = Capacity - 1;
+
+    struct Slot {
+        std::atomic<size_t> seq;
+        UartFrame frame;
+    };
+
+    std::array<Slot, Capacity> slots_;
+    alignas(64) std::atomic<size_t> head_{0}; ///< Vị trí ghi kế tiếp (producer)
+    alignas(64) size_t tail_ = 0;             ///< Vị trí đọc kế tiếp (chỉ consumer)
+};
+
+/**
+ * @brief Ô lệnh chỉ giữ giá trị mới nhất (8 byte data) và cờ dirty, không khóa.
+ *
+ * Producer ghi đè giá trị cũ chưa kịp gửi; luồng TX lấy giá trị mới nhất khi cờ dirty bật.
+ */
+class UartLatestSlot {
+public:
+    /// Ghi giá trị mới, thay cho giá trị chưa gửi (nếu có)
+    void store(const uint8_t data8[8]) {
+        uint64_t value;
+        memcpy(&value, data8, sizeof(value));
+        value_.store(value, std::memory_order_relaxed);
+        dirty_.store(true, std::memory_order_release);
+    }
+
+    /// Đọc giá trị mới nhất, không đổi cờ dirty
+    void load(uint8_t out[8]) const {
+        const uint64_t value = value_.load(std::memory_order_relaxed);
+        memcpy(out, &value, sizeof(value));
+    }
+
+    /// Lấy giá trị mới nhất nếu có giá trị chưa gửi (chỉ luồng tiêu thụ)
+    bool take(uint8_t out[8]) {
+        if (!dirty_.exchange(false, std::memory_order_acq_rel)) return false;
+        const uint64_t value = value_.load(std::memory_order_relaxed);
+        memcpy(out, &value, sizeof(value));
+        return true;
+    }
+
+private:
+    std::atomic<uint64_t> value_{0};
+    std::atomic<bool> dirty_{false};
+};
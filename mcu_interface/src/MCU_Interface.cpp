@@ -1,16 +1,48 @@
 #include "mcu_interface/MCU_Interface.hpp"
-
-UARTNode::UARTNode() : Node("uart_node") {
-    uart_fd_ = open("/dev/ttyUSB0", O_RDWR | O_NOCTTY);
+#include <algorithm>
+#include <poll.h>
+#include <stdexcept>
+#include <sys/eventfd.h>
+#include <rclcpp_components/register_node_macro.hpp>
+
+UARTNode::UARTNode(const rclcpp::NodeOptions& options) : Node("uart_node", options) {
+    // uart_device: cổng tới MCU; uart_latency_bench truyền vào đầu pty của nó
+    std::string device = this->declare_parameter<std::string>("uart_device", "/dev/ttyUSB0");
+    uart_fd_ = open(device.c_str(), O_RDWR | O_NOCTTY);
     if (uart_fd_ < 0) {
-        RCLCPP_ERROR(this->get_logger(), "Failed to open /dev/ttyUSB0");
-        rclcpp::shutdown();
-        return;
+        RCLCPP_ERROR(this->get_logger(), "Failed to open %s", device.c_str());
+        // ném lỗi thay vì rclcpp::shutdown(): trong container chỉ node này nạp thất bại
+        throw std::runtime_error("Failed to open " + device);
     }
 
     this->mode_state = 1;
 
-    configure_port(uart_fd_, B115200);
+    // uart_baud: tốc độ cổng, đồng thời dùng để tính thời gian một frame trên dây (8N1 = 10 bit/byte)
+    int baud = static_cast<int>(this->declare_parameter<int>("uart_baud", 115200));
+    speed_t speed = baud_to_speed(baud);
+    if (speed == B0) {
+        close(uart_fd_);
+        throw std::runtime_error("Unsupported uart_baud " + std::to_string(baud));
+    }
+    configure_port(uart_fd_, speed);
+    byte_wire_time_ = std::chrono::nanoseconds(1000000000LL * 10 / baud);
+
+    // mcu_protocol: "auto" = bắt tay v2, MCU không trả lời trong mcu_handshake_timeout_ms thì dùng frame 12 byte cũ
+    //               "legacy" = luôn dùng frame cũ, "v2" = luôn dùng v2 (mcu_protocol.hpp)
+    std::string protocol = this->declare_parameter<std::string>("mcu_protocol", "auto");
+    handshake_timeout_ = std::chrono::milliseconds(this->declare_parameter<int>("mcu_handshake_timeout_ms", 200));
+    if (protocol == "auto") link_protocol_ = LinkProtocol::PROBING;
+    else if (protocol == "legacy") link_protocol_ = LinkProtocol::LEGACY;
+    else if (protocol == "v2") link_protocol_ = LinkProtocol::V2;
+    else {
+        close(uart_fd_);
+        throw std::runtime_error("mcu_protocol must be auto, legacy or v2, got " + protocol);
+    }
+    tx_event_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (tx_event_fd_ < 0) {
+        close(uart_fd_);
+        throw std::runtime_error(std::string("eventfd failed: ") + strerror(errno));
+    }
 
     pub_imu_ = this->create_publisher<robot_interfaces::msg::IMU>("/imu", 10);
 
@@ -34,19 +66,49 @@ UARTNode::UARTNode() : Node("uart_node") {
         std::bind(&UARTNode::handle_base_cmd, this, std::placeholders::_1)
     );
 
+    configure_realtime();
     uart_read_thread_ = std::thread(&UARTNode::uart_read_loop, this);
-    uart_read_thread_.detach();
-
-    // setup a timer to process the UART queue every 2ms (because baudrate is 115200 so 12byte take 2ms is enough)
-    uart_tx_timer_ = this->create_wall_timer(
-        std::chrono::milliseconds(2), std::bind(&UARTNode::process_uart_queue, this)
-    );
+    apply_thread_rt(uart_read_thread_, "read");
+    RCLCPP_INFO(this->get_logger(), "UART read thread %s",
+                describeThread(uart_read_thread_.native_handle()).c_str());
+
+    // Luồng ghi riêng, thức dậy qua eventfd ngay khi có frame, không phụ thuộc executor
+    uart_write_thread_ = std::thread(&UARTNode::uart_write_loop, this);
+    apply_thread_rt(uart_write_thread_, "write");
+    RCLCPP_INFO(this->get_logger(), "UART write thread %s, %d baud (%.0f us per 12-byte frame), protocol %s",
+                describeThread(uart_write_thread_.native_handle()).c_str(), baud,
+                std::chrono::duration<double, std::micro>(byte_wire_time_ * sizeof(UartFrame)).count(),
+                protocol.c_str());
 
     send_initialization_commands();
 
     RCLCPP_INFO(this->get_logger(), "UART MCU node started.");
 }
 
+UARTNode::~UARTNode() {
+    // Component có thể bị unload khỏi container: dừng luồng đọc/ghi trước khi giải phóng node
+    running_ = false;
+    notify_uart_tx();
+    if (uart_write_thread_.joinable()) uart_write_thread_.join();
+    if (uart_read_thread_.joinable()) uart_read_thread_.join();
+    if (tx_event_fd_ >= 0) close(tx_event_fd_);
+    if (uart_fd_ >= 0) close(uart_fd_);
+}
+
+speed_t UARTNode::baud_to_speed(int baud) {
+    switch (baud) {
+        case 9600: return B9600;
+        case 19200: return B19200;
+        case 38400: return B38400;
+        case 57600: return B57600;
+        case 115200: return B115200;
+        case 230400: return B230400;
+        case 460800: return B460800;
+        case 921600: return B921600;
+        default: return B0;
+    }
+}
+
 void UARTNode::configure_port(int fd, speed_t baudrate) {
     struct termios tty;
     memset(&tty, 0, sizeof(tty));
@@ -67,6 +129,36 @@ void UARTNode::configure_port(int fd, speed_t baudrate) {
     tcsetattr(fd, TCSANOW, &tty);
 }
 
+// Tách luồng đọc/ghi UART khỏi tải camera/YOLO:
+//   uart_rt_priority: SCHED_FIFO 1..99 (0 = giữ SCHED_OTHER)
+//   uart_cpus: CPU affinity (rỗng = mọi CPU)
+//   rt_lock_memory: mlockall để page fault không chặn luồng I/O
+// Cần CAP_SYS_NICE hoặc rtprio trong /etc/security/limits.conf
+void UARTNode::configure_realtime() {
+    bool lock_mem = this->declare_parameter<bool>("rt_lock_memory", false);
+    uart_rt_.priority = static_cast<int>(this->declare_parameter<int>("uart_rt_priority", 0));
+    for (int64_t cpu : this->declare_parameter<std::vector<int64_t>>("uart_cpus", std::vector<int64_t>{})) {
+        uart_rt_.cpus.push_back(static_cast<int>(cpu));
+    }
+
+    if (lock_mem) {
+        std::string error;
+        if (lockMemory(error)) {
+            RCLCPP_INFO(this->get_logger(), "Memory locked (mlockall)");
+        } else {
+            RCLCPP_WARN(this->get_logger(), "%s", error.c_str());
+        }
+    }
+    uart_rt_.prefault_stack = lock_mem;
+}
+
+void UARTNode::apply_thread_rt(std::thread& thread, const char* name) {
+    std::string error;
+    if (!applyRtConfig(thread.native_handle(), uart_rt_, error)) {
+        RCLCPP_WARN(this->get_logger(), "UART %s thread: %s", name, error.c_str());
+    }
+}
+
 void UARTNode::float32_to_little_endian_8byte(float value, uint8_t out[8]) {
     memset(out, 0, 8);
     uint8_t* float_ptr = reinterpret_cast<uint8_t*>(&value);
@@ -75,132 +167,180 @@ void UARTNode::float32_to_little_endian_8byte(float value, uint8_t out[8]) {
     }
 }
 
-void UARTNode::enqueue_uart_packet(uint8_t cmd, const uint8_t* data8) {
-    std::vector<uint8_t> frame = {0x99, 0x02, cmd, 0};
-    for (int i = 0; i < 8; ++i) frame.push_back(data8[i]);
+UartFrame UARTNode::make_uart_frame(uint8_t cmd, const uint8_t* data8) {
+    UartFrame frame{0x99, 0x02, cmd, 0};
+    memcpy(&frame[4], data8, 8);
     uint8_t checksum = 0;
-    for (int i = 0; i < 12; ++i) if (i != 3) checksum += frame[i];
-    frame[3] = checksum % 256;
-    std::lock_guard<std::mutex> lock(uart_queue_mutex_);
-    uart_queue_.push(frame);
+    for (size_t i = 0; i < frame.size(); ++i) if (i != 3) checksum += frame[i];
+    frame[3] = checksum;
+    return frame;
 }
 
-void UARTNode::Senqueue_uart_packet(uint8_t cmd, const uint8_t* data8) {
-    std::vector<uint8_t> frame = {0x99, 0x02, cmd, 0};
-    for (int i = 0; i < 8; ++i) frame.push_back(data8[i]);
-    uint8_t checksum = 0;
-    for (int i = 0; i < 12; ++i) if (i != 3) checksum += frame[i];
-    frame[3] = checksum % 256;
-    std::lock_guard<std::mutex> lock(uart_queue_mutex_);
-    Suart_queue_.push(frame);
+bool UARTNode::Senqueue_uart_packet(uint8_t cmd, const uint8_t* data8) {
+    return Suart_queue_.push(make_uart_frame(cmd, data8));
 }
 
-void UARTNode::process_uart_queue() {
-    std::lock_guard<std::mutex> lock(uart_queue_mutex_);
+void UARTNode::write_uart_bytes(const uint8_t* data, size_t len) {
+    write(uart_fd_, data, len);
 
-    if(!SSuart_queue_.empty()) {
-        std::vector<uint8_t> frame = SSuart_queue_.front();
-        SSuart_queue_.pop();
+    // Log từng frame chỉ ở mức DEBUG (--log-level uart_node:=debug); bình thường không định dạng gì
+    if (!rcutils_logging_logger_is_enabled_for(this->get_logger().get_name(), RCUTILS_LOG_SEVERITY_DEBUG)) return;
 
-        if (SSuart_queue_.size() >= 5) {
-            RCLCPP_WARN(this->get_logger(), "SSUART queue is full, dropping packet.");
-            while(!SSuart_queue_.empty()) {
-                SSuart_queue_.pop();
-            }
-        }
+    // "UART TX [0x99 ...]" dựng trên stack, không cấp phát
+    char text[16 + 5 * mcu_proto::MAX_ENCODED];
+    int n = snprintf(text, sizeof(text), "UART TX [");
+    for (size_t i = 0; i < len && i < mcu_proto::MAX_ENCODED; ++i) {
+        n += snprintf(text + n, sizeof(text) - n, i + 1 < len ? "0x%02X " : "0x%02X]", data[i]);
+    }
+    RCLCPP_DEBUG(this->get_logger(), "%s", text);
+}
 
-        write(uart_fd_, frame.data(), frame.size());
+void UARTNode::notify_uart_tx() {
+    const uint64_t one = 1;
+    [[maybe_unused]] ssize_t n = write(tx_event_fd_, &one, sizeof(one));
+}
 
-        std::ostringstream oss;
-        oss << "UART TX [";
-        for (size_t i = 0; i < frame.size(); ++i) {
-            oss << "0x" << std::hex << std::uppercase << std::setw(2) << std::setfill('0')
-            << static_cast<int>(frame[i]);
-            if (i != frame.size() - 1) oss << " ";
+size_t UARTNode::next_uart_message(uint8_t* out) {
+    const bool v2 = link_protocol_.load(std::memory_order_acquire) == LinkProtocol::V2;
+
+    // SS (request_mcu) trước, rồi S (service), cuối cùng giá trị base_cmd mới nhất
+    UartFrame frame;
+    bool have_frame = false;
+    if (SSuart_queue_.pop(frame)) {
+        if (SSuart_queue_.size() >= 5) {
+            RCLCPP_WARN(this->get_logger(), "SSUART queue is full, dropping packet.");
+            SSuart_queue_.clear();
         }
-        oss << "]";
-        RCLCPP_INFO(this->get_logger(), "%s", oss.str().c_str());
+        have_frame = true;
     }
-    else if(!Suart_queue_.empty()) {
-        std::vector<uint8_t> frame = Suart_queue_.front();
-        Suart_queue_.pop();
-
+    else if (Suart_queue_.pop(frame)) {
         if (Suart_queue_.size() >= 5) {
             RCLCPP_WARN(this->get_logger(), "SUART queue is full, dropping packet.");
-            while(!Suart_queue_.empty()) {
-                Suart_queue_.pop();
-            }
+            Suart_queue_.clear();
         }
+        have_frame = true;
+    }
+    if (have_frame) {
+        if (!v2) {
+            memcpy(out, frame.data(), frame.size());
+            return frame.size();
+        }
+        // v2: lệnh cũ đi trong message COMMAND, bỏ 0x99, checksum và các byte 0 ở cuối
+        uint8_t payload[10] = {frame[1], frame[2]};
+        size_t data_len = 8;
+        while (data_len > 0 && frame[3 + data_len] == 0) --data_len;
+        memcpy(payload + 2, &frame[4], data_len);
+        return mcu_proto::encode(mcu_proto::COMMAND, payload, 2 + data_len, out);
+    }
 
-        write(uart_fd_, frame.data(), frame.size());
-
-        std::ostringstream oss;
-        oss << "UART TX [";
-        for (size_t i = 0; i < frame.size(); ++i) {
-            oss << "0x" << std::hex << std::uppercase << std::setw(2) << std::setfill('0')
-            << static_cast<int>(frame[i]);
-            if (i != frame.size() - 1) oss << " ";
+    uint8_t data[3][8];
+    if (!v2) {
+        // Luân phiên giữa các ô còn dirty để vận tốc 500 Hz không lấn mất góc/xoay
+        for (size_t i = 0; i < base_cmd_slots_.size(); ++i) {
+            const size_t slot = (base_cmd_next_ + i) % base_cmd_slots_.size();
+            if (!base_cmd_slots_[slot].take(data[0])) continue;
+            base_cmd_next_ = slot + 1;
+            frame = make_uart_frame(BASE_CMD_IDS[slot], data[0]);
+            memcpy(out, frame.data(), frame.size());
+            return frame.size();
         }
-        oss << "]";
-        RCLCPP_INFO(this->get_logger(), "%s", oss.str().c_str());
+        return 0;
     }
-    else{
-        if (!uart_queue_.empty()) {
-            std::vector<uint8_t> frame = uart_queue_.front();
-            uart_queue_.pop();
-
-            if (uart_queue_.size() >= 10) {
-                RCLCPP_WARN(this->get_logger(), "UART queue is full, dropping packet.");
-                while(!uart_queue_.empty()) {
-                    uart_queue_.pop();
-                }
-            }
 
-            write(uart_fd_, frame.data(), frame.size());
+    // v2: vận tốc, góc và xoay đi chung một message BASE_CMD khi có ô nào thay đổi
+    bool dirty = false;
+    for (size_t slot = 0; slot < base_cmd_slots_.size(); ++slot) {
+        if (base_cmd_slots_[slot].take(data[slot])) dirty = true;
+        else base_cmd_slots_[slot].load(data[slot]);
+    }
+    if (!dirty) return 0;
+    uint8_t payload[9];
+    memcpy(payload, data[0], 4);
+    memcpy(payload + 4, data[1], 4);
+    payload[8] = data[2][0];
+    return mcu_proto::encode(mcu_proto::BASE_CMD, payload, sizeof(payload), out);
+}
+
+void UARTNode::uart_write_loop() {
+    if (uart_rt_.prefault_stack) prefaultStack();
+    // Thời điểm sớm nhất được ghi message kế tiếp: message trước đã ra hết dây, MCU không bị tràn
+    auto next_slot = std::chrono::steady_clock::now();
+    uint8_t buf[mcu_proto::MAX_ENCODED];
+
+    // Bắt tay v2: khung HELLO không chứa 0x99 nên MCU đời cũ bỏ qua
+    auto handshake_deadline = std::chrono::steady_clock::time_point::max();
+    if (link_protocol_.load(std::memory_order_acquire) == LinkProtocol::PROBING) {
+        const uint8_t version = mcu_proto::VERSION;
+        const size_t len = mcu_proto::encode(mcu_proto::HELLO, &version, 1, buf);
+        write_uart_bytes(buf, len);
+        next_slot = std::chrono::steady_clock::now() + byte_wire_time_ * len;
+        handshake_deadline = std::chrono::steady_clock::now() + handshake_timeout_;
+    }
 
-            std::ostringstream oss;
-            oss << "UART TX [";
-            for (size_t i = 0; i < frame.size(); ++i) {
-                oss << "0x" << std::hex << std::uppercase << std::setw(2) << std::setfill('0')
-                << static_cast<int>(frame[i]);
-                if (i != frame.size() - 1) oss << " ";
+    while (running_) {
+        // Ngủ tới khi có message; timeout 100 ms chỉ để chắc chắn thấy running_ và hạn bắt tay
+        int timeout_ms = 100;
+        if (link_protocol_.load(std::memory_order_acquire) == LinkProtocol::PROBING) {
+            const auto left = std::chrono::ceil<std::chrono::milliseconds>(handshake_deadline - std::chrono::steady_clock::now());
+            timeout_ms = static_cast<int>(std::clamp<int64_t>(left.count(), 0, 100));
+        }
+        struct pollfd pfd{tx_event_fd_, POLLIN, 0};
+        const int ready = poll(&pfd, 1, timeout_ms);
+        if (std::chrono::steady_clock::now() >= handshake_deadline) {
+            handshake_deadline = std::chrono::steady_clock::time_point::max();
+            LinkProtocol expected = LinkProtocol::PROBING;
+            if (link_protocol_.compare_exchange_strong(expected, LinkProtocol::LEGACY)) {
+                RCLCPP_WARN(this->get_logger(), "MCU did not answer the v2 handshake, using legacy 12-byte frames");
             }
-            oss << "]";
-            RCLCPP_INFO(this->get_logger(), "%s", oss.str().c_str());
+        }
+        if (ready <= 0) continue;
+        uint64_t count;
+        [[maybe_unused]] ssize_t n = read(tx_event_fd_, &count, sizeof(count));
+
+        // Chọn message ngay trước khi ghi để base_cmd luôn là giá trị mới nhất
+        while (running_) {
+            std::this_thread::sleep_until(next_slot);
+            const size_t len = next_uart_message(buf);
+            if (len == 0) break;
+            write_uart_bytes(buf, len);
+            next_slot = std::chrono::steady_clock::now() + byte_wire_time_ * len;
         }
     }
 }
 
 void UARTNode::send_initialization_commands() {
-    std::vector<std::vector<uint8_t>> init_cmds = {
+    const UartFrame init_cmds[] = {
         {0x99, 0x01, 0x05, 0x71, 0x64, 0x00, 0x64, 0x00, 0x0A, 0x00, 0x00, 0x00},
         {0x99, 0x01, 0x00, 0x9B, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
         {0x99, 0x01, 0x00, 0x9A, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
         {0x99, 0x01, 0x02, 0x9D, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}
     };
-    for (auto& frame : init_cmds){
+    for (const auto& frame : init_cmds){
         Suart_queue_.push(frame);
     }
+    notify_uart_tx();
 }
 
 // Cai data rot nay t dang thuc thi theo kieu xoay 4 huong trai, phai, stop_turn, back tozero nhe don.
 void UARTNode::handle_base_cmd(const robot_interfaces::msg::BaseCmd::SharedPtr msg) {
+    // Chỉ ghi đè giá trị mới nhất; luồng ghi gửi, không tích backlog khi gamepad publish nhanh hơn UART
     uint8_t data_vel[8];
     float32_to_little_endian_8byte(msg->velocity, data_vel);
-    enqueue_uart_packet(0x0E, data_vel);
+    base_cmd_slots_[0].store(data_vel);
 
     uint8_t data_ang[8];
     float32_to_little_endian_8byte(msg->angle, data_ang);
-    enqueue_uart_packet(0x0F, data_ang);
+    base_cmd_slots_[1].store(data_ang);
 
     uint8_t data_rot[8] = {msg->rotate, 0, 0, 0, 0, 0, 0, 0};
-    enqueue_uart_packet(0x10, data_rot);
+    base_cmd_slots_[2].store(data_rot);
+    notify_uart_tx();
 }
 
 // cai rot nay la t thuc thi theo kieu assign nhe tai anh thinh gui theo kieu float.
 void UARTNode::handle_rotate_service(const std::shared_ptr<robot_interfaces::srv::RotateBase::Request> request,
                                      std::shared_ptr<robot_interfaces::srv::RotateBase::Response> response) {
-    SSuart_queue_.push(FRAME_ROTATE_MODE);
+    bool ok = SSuart_queue_.push(FRAME_ROTATE_MODE);
     float angle = request->angle;
     uint8_t data[8];
     float32_to_little_endian_8byte(angle, data);
@@ -209,33 +349,35 @@ void UARTNode::handle_rotate_service(const std::shared_ptr<robot_interfaces::srv
     }
     data[0] = 0x04;
 
-    Senqueue_uart_packet(0x10, data);
-    response->success = true;
+    ok = Senqueue_uart_packet(0x10, data) && ok;
+    notify_uart_tx();
+    response->success = ok;
 }
 
 void UARTNode::handle_request_mcu_service(
     const std::shared_ptr<robot_interfaces::srv::RequestMcu::Request> request,
     std::shared_ptr<robot_interfaces::srv::RequestMcu::Response> response) {
     uint8_t cmd = request->action;
-    std::vector<std::vector<uint8_t>> frames;
+    UartFrame frames[2];
+    size_t count = 0;
 
     switch (cmd) {
-        case 0: frames.push_back(FRAME_IDLE); break;
-        case 1: frames.push_back(FRAME_CLOSED_LOOP); break;
-        case 2: frames.push_back(FRAME_HOMING); break;
-        case 3: frames.push_back(FRAME_RESET_IMU); frames.push_back(FRAME_RESET_ENCODER); break;
-        case 4: frames.push_back(FRAME_CLEAR_ERRORS); break;
+        case 0: frames[count++] = FRAME_IDLE; break;
+        case 1: frames[count++] = FRAME_CLOSED_LOOP; break;
+        case 2: frames[count++] = FRAME_HOMING; break;
+        case 3: frames[count++] = FRAME_RESET_IMU; frames[count++] = FRAME_RESET_ENCODER; break;
+        case 4: frames[count++] = FRAME_CLEAR_ERRORS; break;
         case 5: {
-            if (this->mode_state == 0) frames.push_back(FRAME_MANUAL_MODE);
-            else if (this->mode_state == 1) frames.push_back(FRAME_SEMI_AUTO_MODE);
+            if (this->mode_state == 0) frames[count++] = FRAME_MANUAL_MODE;
+            else if (this->mode_state == 1) frames[count++] = FRAME_SEMI_AUTO_MODE;
             this->mode_state = (this->mode_state + 1) % 2;
             break;
         }
-        case 6: frames.push_back(FRAME_AUTO_IDLE); break; // set up lai chu trinh 1
-        case 7: frames.push_back(FRAME_GO_BACK); break; // set up lai chu trinh 2
-        case 8: frames.push_back(FRAME_GO_STRAIGHT); break; // set up lai chu trinh 3
-        case 9: frames.push_back(FRAME_TURN_LEFT); break; // set up lai chu trinh 4
-        case 10: frames.push_back(FRAME_EMERGENCY_STOP); break;
+        case 6: frames[count++] = FRAME_AUTO_IDLE; break; // set up lai chu trinh 1
+        case 7: frames[count++] = FRAME_GO_BACK; break; // set up lai chu trinh 2
+        case 8: frames[count++] = FRAME_GO_STRAIGHT; break; // set up lai chu trinh 3
+        case 9: frames[count++] = FRAME_TURN_LEFT; break; // set up lai chu trinh 4
+        case 10: frames[count++] = FRAME_EMERGENCY_STOP; break;
 
         default:
             RCLCPP_WARN(this->get_logger(), "Unknown base_control cmd: %d", cmd);
@@ -243,14 +385,14 @@ void UARTNode::handle_request_mcu_service(
             return;
     }
 
-    {
-        std::lock_guard<std::mutex> lock(uart_queue_mutex_);
-        for (const auto& frame : frames) {
-            SSuart_queue_.push(frame);
-        }
+    bool ok = true;
+    for (size_t i = 0; i < count; ++i) {
+        ok = SSuart_queue_.push(frames[i]) && ok;
     }
+    notify_uart_tx();
+    if (!ok) RCLCPP_WARN(this->get_logger(), "SSUART queue is full, request_mcu %d dropped", cmd);
 
-    response->success = true;
+    response->success = ok;
 }
 
 void UARTNode::handle_push_ball_service(const std::shared_ptr<robot_interfaces::srv::PushBall::Request> request,
@@ -259,10 +401,8 @@ void UARTNode::handle_push_ball_service(const std::shared_ptr<robot_interfaces::
         response->success = false;
         return;
     }
-    std::vector<uint8_t> frame = FRAME_PUSH_BALL;
-    std::lock_guard<std::mutex> lock(uart_queue_mutex_);
-    Suart_queue_.push(frame);
-    response->success = true;
+    response->success = Suart_queue_.push(FRAME_PUSH_BALL);
+    notify_uart_tx();
 
     this->mode_state = 0;
 }
@@ -272,68 +412,148 @@ float UARTNode::convert_to_angle(uint8_t low, uint8_t high) {
 }
 
 void UARTNode::uart_read_loop() {
-    while (rclcpp::ok()) {
-        uint8_t byte;
-        int n = read(uart_fd_, &byte, 1);
-        if (n <= 0) {
-            std::this_thread::sleep_for(std::chrono::microseconds(100));
+    if (uart_rt_.prefault_stack) prefaultStack();
+    while (running_ && rclcpp::ok()) {
+        // chờ có byte tối đa 100 ms để còn kiểm tra running_
+        struct pollfd pfd{uart_fd_, POLLIN, 0};
+        if (poll(&pfd, 1, 100) <= 0) continue;
+        if (pfd.revents & (POLLERR | POLLHUP | POLLNVAL)) {
+            // USB-TTL bị rút: tránh quay vòng liên tục trên fd lỗi
+            RCLCPP_ERROR(this->get_logger(), "UART read error (revents 0x%x)", pfd.revents);
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
             continue;
         }
 
-        if (!syncing_) {
-            if (byte == 0x99) {
-                buffer_.clear();
-                buffer_.push_back(byte);
-                syncing_ = true;
-            }
-        } else {
-            buffer_.push_back(byte);
-            if (buffer_.size() == 3 && buffer_[2] != 0x01) {
-                syncing_ = false;
-                buffer_.clear();
-                continue;
+        // Đọc hết những gì driver đang giữ vào phần trống của rx_buf_ (một syscall cho nhiều frame)
+        ssize_t n = read(uart_fd_, rx_buf_.data() + rx_len_, rx_buf_.size() - rx_len_);
+        if (n <= 0) continue;
+        rx_len_ += static_cast<size_t>(n);
+
+        const size_t used = parse_rx(rx_buf_.data(), rx_len_);
+        // Phần frame dở dang dời về đầu buffer cho lần đọc sau
+        rx_len_ -= used;
+        if (rx_len_ > 0 && used > 0) memmove(rx_buf_.data(), rx_buf_.data() + used, rx_len_);
+    }
+}
+
+size_t UARTNode::parse_rx(const uint8_t* data, size_t len) {
+    LinkProtocol protocol = link_protocol_.load(std::memory_order_acquire);
+    if (protocol == LinkProtocol::V2) return parse_rx_v2(data, len);
+    if (protocol == LinkProtocol::PROBING && find_hello_ack(data, len)) {
+        if (link_protocol_.compare_exchange_strong(protocol, LinkProtocol::V2)) {
+            RCLCPP_INFO(this->get_logger(), "MCU answered the v2 handshake, switching to COBS/CRC-16 messages");
+        }
+        return len;
+    }
+    if (protocol == LinkProtocol::PROBING) {
+        // HELLO_ACK có thể bị cắt giữa hai lần read(): giữ lại phần sau byte 0x00 cuối cùng
+        // (tối đa một khung dài nhất) để lần sau ghép đủ; frame cũ trong phần đó xử lý ở lần sau
+        size_t tail = 0;
+        while (tail < len && tail < mcu_proto::MAX_ENCODED && data[len - 1 - tail] != 0x00) ++tail;
+        return parse_rx_frames(data, len - tail);
+    }
+    return parse_rx_frames(data, len);
+}
+
+bool UARTNode::find_hello_ack(const uint8_t* data, size_t len) {
+    // Frame cũ cũng chứa byte 0: mọi đoạn giữa hai byte 0 đều thử giải mã, CRC loại đoạn sai
+    size_t pos = 0;
+    mcu_proto::Message msg;
+    while (pos < len) {
+        const void* end = memchr(data + pos, 0x00, len - pos);
+        if (end == nullptr) return false;
+        const size_t frame_len = static_cast<size_t>(static_cast<const uint8_t*>(end) - data) - pos;
+        if (frame_len > 0 && mcu_proto::decode(data + pos, frame_len, msg) &&
+            msg.type == mcu_proto::HELLO_ACK && msg.len >= 1) {
+            if (msg.payload[0] == mcu_proto::VERSION) return true;
+            RCLCPP_WARN(this->get_logger(), "MCU answered with protocol version %d, expected %d",
+                        msg.payload[0], mcu_proto::VERSION);
+        }
+        pos += frame_len + 1;
+    }
+    return false;
+}
+
+size_t UARTNode::parse_rx_v2(const uint8_t* data, size_t len) {
+    size_t pos = 0;
+    mcu_proto::Message msg;
+    while (pos < len) {
+        // Mỗi khung kết thúc bằng byte 0x00
+        const void* end = memchr(data + pos, 0x00, len - pos);
+        if (end == nullptr) {
+            // Không có 0x00 trong khoảng một khung dài nhất: rác, bỏ đi
+            return (len - pos > mcu_proto::MAX_ENCODED) ? len : pos;
+        }
+        const size_t frame_len = static_cast<size_t>(static_cast<const uint8_t*>(end) - data) - pos;
+        if (frame_len > 0) {
+            if (mcu_proto::decode(data + pos, frame_len, msg)) {
+                handle_v2_message(msg);
+            } else {
+                RCLCPP_WARN(this->get_logger(), "UART v2 frame dropped (COBS/CRC error, %zu bytes)", frame_len);
             }
+        }
+        pos += frame_len + 1;
+    }
+    return pos;
+}
 
-            if (buffer_.size() == 12) {
-                syncing_ = false;
-                if (buffer_[2] == 0x01) {
-                    uint8_t checksum = 0;
-                    for (int i = 0; i < 12; ++i) {
-                        if (i != 3) checksum += buffer_[i];
-                    }
-                    if (buffer_[3] != (checksum % 256)) {
-                        std::stringstream ss;
-                        ss << "Checksum error! Buffer = [ ";
-                        for (uint8_t b : buffer_) {
-                            ss << "0x" << std::hex << std::setw(2) << std::setfill('0') << static_cast<int>(b) << " ";
-                        }
-                        ss << "]";
-                        RCLCPP_WARN(this->get_logger(), "%s", ss.str().c_str());
-                        continue;
-                    }
-
-                    // std::stringstream ss;
-                    // ss << "Buffer receive = [ ";
-                    // for (uint8_t b : buffer_) {
-                    //     ss << "0x" << std::hex << std::setw(2) << std::setfill('0') << static_cast<int>(b) << " ";
-                    // }
-                    // ss << "]";
-                    // RCLCPP_WARN(this->get_logger(), "%s", ss.str().c_str());
-                    
-                    float z = convert_to_angle(buffer_[8], buffer_[9]);
-                    robot_interfaces::msg::IMU msg;
-                    msg.angle = z;
-                    pub_imu_->publish(msg);
-                }
+void UARTNode::handle_v2_message(const mcu_proto::Message& msg) {
+    switch (msg.type) {
+        case mcu_proto::TELEMETRY: {
+            // [n][n × yaw int16 LE]: publish từng mẫu theo thứ tự
+            const size_t count = msg.len > 0 ? msg.payload[0] : 0;
+            for (size_t i = 0; i < count && 2 + 2 * i < msg.len; ++i) {
+                auto imu = std::make_unique<robot_interfaces::msg::IMU>();
+                imu->angle = convert_to_angle(msg.payload[1 + 2 * i], msg.payload[2 + 2 * i]);
+                pub_imu_->publish(std::move(imu));
             }
+            break;
         }
+        case mcu_proto::HELLO_ACK:
+            break;
+        default:
+            RCLCPP_DEBUG(this->get_logger(), "Unknown UART v2 message type 0x%02X", msg.type);
+            break;
     }
 }
 
+size_t UARTNode::parse_rx_frames(const uint8_t* data, size_t len) {
+    size_t pos = 0;
+    while (pos < len) {
+        // Nhảy thẳng tới byte đồng bộ 0x99, bỏ qua rác ở giữa
+        const void* sync = memchr(data + pos, 0x99, len - pos);
+        if (sync == nullptr) return len;
+        pos = static_cast<size_t>(static_cast<const uint8_t*>(sync) - data);
+        if (len - pos < RX_FRAME_SIZE) return pos;
+
+        const uint8_t* frame = data + pos;
+        if (frame[2] != 0x01) {
+            // 0x99 nằm trong payload: đồng bộ lại từ byte kế tiếp
+            ++pos;
+            continue;
+        }
+        uint8_t checksum = 0;
+        for (size_t i = 0; i < RX_FRAME_SIZE; ++i) {
+            if (i != 3) checksum += frame[i];
+        }
+        if (frame[3] != checksum) {
+            std::stringstream ss;
+            ss << "Checksum error! Buffer = [ ";
+            for (size_t i = 0; i < RX_FRAME_SIZE; ++i) {
+                ss << "0x" << std::hex << std::setw(2) << std::setfill('0') << static_cast<int>(frame[i]) << " ";
+            }
+            ss << "]";
+            RCLCPP_WARN(this->get_logger(), "%s", ss.str().c_str());
+            ++pos;
+            continue;
+        }
 
-int main(int argc, char* argv[]) {
-    rclcpp::init(argc, argv);
-    rclcpp::spin(std::make_shared<UARTNode>());
-    rclcpp::shutdown();
-    return 0;
+        auto msg = std::make_unique<robot_interfaces::msg::IMU>();
+        msg->angle = convert_to_angle(frame[8], frame[9]);
+        pub_imu_->publish(std::move(msg));
+        pos += RX_FRAME_SIZE;
+    }
+    return pos;
 }
+
+RCLCPP_COMPONENTS_REGISTER_NODE(UARTNode)
@@ -0,0 +1,71 @@
+#include "mcu_interface/mcu_protocol.hpp"
+#include <cstring>
+
+namespace mcu_proto {
+
+// Khung HELLO gửi cả tới MCU đời cũ: không được chứa byte đồng bộ 0x99 của frame 12 byte
+constexpr uint8_t HELLO_RAW[] = {HELLO, VERSION};
+static_assert((crc16(HELLO_RAW, 2) & 0xFF) != 0x99 && (crc16(HELLO_RAW, 2) >> 8) != 0x99,
+              "HELLO must not look like a legacy frame");
+
+size_t encode(uint8_t type, const uint8_t* payload, size_t len, uint8_t* out) {
+    if (len > MAX_PAYLOAD) return 0;
+    uint8_t raw[MAX_RAW];
+    raw[0] = type;
+    if (len > 0) memcpy(raw + 1, payload, len);
+    const uint16_t crc = crc16(raw, len + 1);
+    raw[len + 1] = static_cast<uint8_t>(crc & 0xFF);
+    raw[len + 2] = static_cast<uint8_t>(crc >> 8);
+    const size_t raw_len = len + 3;
+
+    // COBS: mỗi khối bắt đầu bằng byte mã = khoảng cách tới byte 0 kế tiếp (tối đa 254 byte dữ liệu)
+    size_t code_pos = 0;
+    size_t o = 1;
+    uint8_t code = 1;
+    for (size_t i = 0; i < raw_len; ++i) {
+        if (raw[i] == 0) {
+            out[code_pos] = code;
+            code_pos = o++;
+            code = 1;
+        } else {
+            out[o++] = raw[i];
+            if (++code == 0xFF) {
+                out[code_pos] = code;
+                code_pos = o++;
+                code = 1;
+            }
+        }
+    }
+    out[code_pos] = code;
+    out[o++] = 0x00;
+    return o;
+}
+
+bool decode(const uint8_t* frame, size_t len, Message& out) {
+    uint8_t raw[MAX_RAW];
+    size_t n = 0;
+    size_t i = 0;
+    while (i < len) {
+        const uint8_t code = frame[i++];
+        if (code == 0) return false;
+        for (uint8_t k = 1; k < code; ++k) {
+            if (i >= len || n >= MAX_RAW) return false;
+            raw[n++] = frame[i++];
+        }
+        // Khối ngắn hơn 254 byte kết thúc bằng một byte 0, trừ khối cuối cùng
+        if (code < 0xFF && i < len) {
+            if (n >= MAX_RAW) return false;
+            raw[n++] = 0;
+        }
+    }
+    if (n < 3) return false;
+
+    const uint16_t crc = static_cast<uint16_t>(raw[n - 2] | (raw[n - 1] << 8));
+    if (crc16(raw, n - 2) != crc) return false;
+    out.type = raw[0];
+    out.len = n - 3;
+    if (out.len > 0) memcpy(out.payload, raw + 1, out.len);
+    return true;
+}
+
+} // namespace mcu_proto
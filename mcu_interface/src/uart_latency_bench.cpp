@@ -0,0 +1,154 @@
+// Đo độ trễ /base_cmd → frame UART của uart_node, thay gamepad_node bằng một publisher.
+// Bench tạo một pty, uart_node ghi vào đầu slave (uart_device:=<tty_link>), bench đọc đầu master.
+//   ros2 launch robot_bringup uart_latency_bench.launch.py intra_process:=true   # cùng container
+//   ros2 launch robot_bringup uart_latency_bench.launch.py intra_process:=false  # hai process, qua DDS
+// Xong thì bench log DONE_MARKER, launch file bắt dòng đó và dừng mọi process.
+#include <rclcpp/rclcpp.hpp>
+#include <rclcpp_components/register_node_macro.hpp>
+#include "robot_interfaces/msg/base_cmd.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <pty.h>
+#include <stdexcept>
+#include <termios.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+class UartLatencyBench : public rclcpp::Node {
+public:
+    static constexpr const char* DONE_MARKER = "UART latency benchmark done"; ///< uart_latency_bench.launch.py chờ dòng này
+
+    explicit UartLatencyBench(const rclcpp::NodeOptions& options = rclcpp::NodeOptions())
+        : Node("uart_latency_bench", options) {
+        tty_link_ = this->declare_parameter<std::string>("tty_link", "/tmp/uart_bench_tty");
+        iterations_ = static_cast<int>(this->declare_parameter<int>("iterations", 500));
+        auto period_ms = this->declare_parameter<int>("period_ms", 20);
+
+        // pty thay cho USB-TTL; giữ slave mở để master không báo EIO khi uart_node chưa mở
+        if (openpty(&master_fd_, &slave_fd_, nullptr, nullptr, nullptr) != 0) {
+            throw std::runtime_error(std::string("openpty failed: ") + strerror(errno));
+        }
+        struct termios tty;
+        tcgetattr(slave_fd_, &tty);
+        cfmakeraw(&tty);
+        tcsetattr(slave_fd_, TCSANOW, &tty);
+        unlink(tty_link_.c_str());
+        if (symlink(ptsname(master_fd_), tty_link_.c_str()) != 0) {
+            throw std::runtime_error("Could not create " + tty_link_ + ": " + strerror(errno));
+        }
+
+        sent_ns_ = std::vector<std::atomic<uint64_t>>(iterations_);
+        recv_ns_ = std::vector<std::atomic<uint64_t>>(iterations_);
+        pub_base_cmd_ = this->create_publisher<robot_interfaces::msg::BaseCmd>("/base_cmd", 10);
+        reader_ = std::thread(&UartLatencyBench::read_loop, this);
+        timer_ = this->create_wall_timer(std::chrono::milliseconds(period_ms),
+                                         std::bind(&UartLatencyBench::tick, this));
+        RCLCPP_INFO(this->get_logger(), "Benchmarking %d /base_cmd messages, uart_device:=%s (intra-process %s)",
+                    iterations_, tty_link_.c_str(),
+                    this->get_node_options().use_intra_process_comms() ? "on" : "off");
+    }
+
+    ~UartLatencyBench() override {
+        running_ = false;
+        if (reader_.joinable()) reader_.join();
+        unlink(tty_link_.c_str());
+        close(master_fd_);
+        close(slave_fd_);
+    }
+
+private:
+    static uint64_t now_ns() {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    void tick() {
+        // uart_node chưa mở pty thì chưa có subscriber
+        if (pub_base_cmd_->get_subscription_count() + pub_base_cmd_->get_intra_process_subscription_count() == 0) {
+            RCLCPP_WARN(this->get_logger(), "Waiting for uart_node on /base_cmd ...");
+            return;
+        }
+        if (sent_ >= iterations_) {
+            // Không gọi rclcpp::shutdown(): trong container nó dừng cả uart_node và các node khác.
+            // Launch file thấy DONE_MARKER trên log và tự kết thúc lần chạy
+            report();
+            timer_->cancel();
+            RCLCPP_INFO(this->get_logger(), "%s", DONE_MARKER);
+            return;
+        }
+        // velocity = số thứ tự (số nguyên, float biểu diễn chính xác) để nhận ra frame 0x0E tương ứng
+        auto msg = std::make_unique<robot_interfaces::msg::BaseCmd>();
+        msg->velocity = static_cast<float>(sent_ + 1);
+        msg->angle = 0.0f;
+        msg->rotate = 0;
+        sent_ns_[sent_].store(now_ns(), std::memory_order_release);
+        pub_base_cmd_->publish(std::move(msg));
+        ++sent_;
+    }
+
+    // Ghép frame 12 byte 0x99 ... và lấy velocity của lệnh 0x0E
+    void read_loop() {
+        std::vector<uint8_t> frame;
+        uint8_t buf[256];
+        while (running_) {
+            struct pollfd pfd{master_fd_, POLLIN, 0};
+            if (poll(&pfd, 1, 100) <= 0) continue;
+            ssize_t n = read(master_fd_, buf, sizeof(buf));
+            const uint64_t t = now_ns();
+            for (ssize_t i = 0; i < n; ++i) {
+                if (frame.empty() && buf[i] != 0x99) continue;
+                frame.push_back(buf[i]);
+                if (frame.size() < 12) continue;
+                if (frame[2] == 0x0E) {
+                    float vel;
+                    memcpy(&vel, &frame[4], sizeof(float));
+                    const int idx = static_cast<int>(vel) - 1;
+                    if (idx >= 0 && idx < iterations_ && recv_ns_[idx].load(std::memory_order_relaxed) == 0) {
+                        recv_ns_[idx].store(t, std::memory_order_release);
+                    }
+                }
+                frame.clear();
+            }
+        }
+    }
+
+    void report() {
+        std::vector<uint64_t> lat;
+        for (int i = 0; i < iterations_; ++i) {
+            const uint64_t t0 = sent_ns_[i].load(std::memory_order_acquire);
+            const uint64_t t1 = recv_ns_[i].load(std::memory_order_acquire);
+            if (t0 != 0 && t1 > t0) lat.push_back(t1 - t0);
+        }
+        if (lat.empty()) {
+            RCLCPP_ERROR(this->get_logger(), "No 0x0E frames received on %s", tty_link_.c_str());
+            return;
+        }
+        std::sort(lat.begin(), lat.end());
+        auto pct = [&lat](double q) {
+            return static_cast<double>(lat[static_cast<size_t>(q * static_cast<double>(lat.size() - 1))]) / 1000.0;
+        };
+        RCLCPP_INFO(this->get_logger(), "%zu/%d samples, intra-process %s",
+                    lat.size(), iterations_, this->get_node_options().use_intra_process_comms() ? "on" : "off");
+        RCLCPP_INFO(this->get_logger(), "base_cmd -> UART  p50 %8.1f us  p99 %8.1f us  max %8.1f us",
+                    pct(0.5), pct(0.99), pct(1.0));
+    }
+
+    std::string tty_link_;
+    int iterations_;
+    int sent_ = 0;
+    int master_fd_ = -1;
+    int slave_fd_ = -1;
+    std::atomic<bool> running_{true};
+    std::vector<std::atomic<uint64_t>> sent_ns_;
+    std::vector<std::atomic<uint64_t>> recv_ns_;
+    std::thread reader_;
+    rclcpp::Publisher<robot_interfaces::msg::BaseCmd>::SharedPtr pub_base_cmd_;
+    rclcpp::TimerBase::SharedPtr timer_;
+};
+
+RCLCPP_COMPONENTS_REGISTER_NODE(UartLatencyBench)
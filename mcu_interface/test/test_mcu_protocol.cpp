@@ -0,0 +1,81 @@
+#include <gtest/gtest.h>
+#include "mcu_interface/mcu_protocol.hpp"
+
+#include <cstring>
+#include <vector>
+
+namespace {
+
+// Mã hóa rồi giải mã lại (bỏ byte 0x00 cuối khung)
+bool round_trip(uint8_t type, const std::vector<uint8_t>& payload, mcu_proto::Message& out) {
+    uint8_t buf[mcu_proto::MAX_ENCODED];
+    const size_t n = mcu_proto::encode(type, payload.data(), payload.size(), buf);
+    if (n == 0 || buf[n - 1] != 0x00) return false;
+    return mcu_proto::decode(buf, n - 1, out);
+}
+
+} // namespace
+
+TEST(McuProtocol, Crc16CheckValue) {
+    // Giá trị kiểm tra chuẩn của CRC-16/CCITT-FALSE
+    const uint8_t text[] = {'1', '2', '3', '4', '5', '6', '7', '8', '9'};
+    EXPECT_EQ(mcu_proto::crc16(text, sizeof(text)), 0x29B1);
+    EXPECT_EQ(mcu_proto::crc16(text, 0), 0xFFFF);
+}
+
+TEST(McuProtocol, EncodedFrameHasSingleTrailingZero) {
+    const uint8_t payload[] = {0x00, 0x11, 0x00, 0x00, 0x22};
+    uint8_t buf[mcu_proto::MAX_ENCODED];
+    const size_t n = mcu_proto::encode(mcu_proto::COMMAND, payload, sizeof(payload), buf);
+    ASSERT_GT(n, 0u);
+    EXPECT_EQ(buf[n - 1], 0x00);
+    EXPECT_EQ(memchr(buf, 0x00, n - 1), nullptr);
+}
+
+TEST(McuProtocol, RoundTripPayloads) {
+    const std::vector<std::vector<uint8_t>> payloads = {
+        {},
+        {mcu_proto::VERSION},
+        {0x00},
+        {0x00, 0x00, 0x00},
+        {0x12, 0x00, 0x34, 0xFF, 0x00},
+        std::vector<uint8_t>(mcu_proto::MAX_PAYLOAD, 0x00),
+        std::vector<uint8_t>(mcu_proto::MAX_PAYLOAD, 0xA5),
+    };
+    for (const auto& payload : payloads) {
+        mcu_proto::Message msg;
+        ASSERT_TRUE(round_trip(mcu_proto::TELEMETRY, payload, msg)) << "payload size " << payload.size();
+        EXPECT_EQ(msg.type, mcu_proto::TELEMETRY);
+        ASSERT_EQ(msg.len, payload.size());
+        EXPECT_EQ(memcmp(msg.payload, payload.data(), payload.size()), 0);
+    }
+}
+
+TEST(McuProtocol, EncodeRejectsOversizedPayload) {
+    const std::vector<uint8_t> payload(mcu_proto::MAX_PAYLOAD + 1, 0x01);
+    uint8_t buf[mcu_proto::MAX_ENCODED + 8];
+    EXPECT_EQ(mcu_proto::encode(mcu_proto::COMMAND, payload.data(), payload.size(), buf), 0u);
+}
+
+TEST(McuProtocol, DecodeRejectsCorruptFrames) {
+    const uint8_t payload[] = {mcu_proto::VERSION};
+    uint8_t buf[mcu_proto::MAX_ENCODED];
+    const size_t n = mcu_proto::encode(mcu_proto::HELLO_ACK, payload, sizeof(payload), buf);
+    ASSERT_GT(n, 1u);
+    mcu_proto::Message msg;
+
+    // Sai một bit bất kỳ: CRC phải bắt được
+    for (size_t i = 0; i + 1 < n; ++i) {
+        uint8_t bad[mcu_proto::MAX_ENCODED];
+        memcpy(bad, buf, n);
+        bad[i] ^= 0x04;
+        EXPECT_FALSE(mcu_proto::decode(bad, n - 1, msg)) << "flipped byte " << i;
+    }
+    // Khung cụt và byte 0 nằm giữa khung
+    EXPECT_FALSE(mcu_proto::decode(buf, n - 2, msg));
+    EXPECT_FALSE(mcu_proto::decode(buf, 0, msg));
+    uint8_t zero_inside[mcu_proto::MAX_ENCODED];
+    memcpy(zero_inside, buf, n);
+    zero_inside[1] = 0x00;
+    EXPECT_FALSE(mcu_proto::decode(zero_inside, n - 1, msg));
+}
@@ -1,11 +1,13 @@
 #ifndef CAN_COMM_HPP_
 #define CAN_COMM_HPP_
 
+#include <array>
 #include <string>
-#include <vector>
+#include <span>
 #include <cstdint>
 #include <iostream>
 #include <cstring>
+#include <cerrno>
 #include <net/if.h>
 #include <sys/ioctl.h>
 #include <sys/socket.h>
@@ -13,30 +15,173 @@
 #include <linux/can.h>
 #include <linux/can/raw.h>
 #include <functional>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include "can_trace.hpp"
+#include "rt_thread.hpp"
 
-using FeedbackCallback = std::function<void(uint32_t frame_id, const uint8_t *data)>;
+// timestamp_ns: kernel receive time (SO_TIMESTAMPING) mapped onto CLOCK_MONOTONIC
+using FeedbackCallback = std::function<void(uint32_t frame_id, const uint8_t *data,
+                                            uint8_t len, uint64_t timestamp_ns)>;
+
+// Receiver for frames addressed to one ODrive node (frame_id >> 5)
+class CANNodeHandler
+{
+public:
+    virtual ~CANNodeHandler() = default;
+    // Called on the RX thread; must not block
+    virtual void onFrame(uint8_t cmd_id, const uint8_t *data, uint8_t len, uint64_t timestamp_ns) = 0;
+    // Called on the sending thread once sendmmsg() accepted a frame for this node; must not block
+    virtual void onTransmit(uint8_t, const uint8_t *, uint8_t, uint64_t) {}
+};
+
+// Cumulative traffic counters; diff two snapshots to get rates.
+// rx_* only see frames that passed the kernel CAN filters, so tx + rx is the
+// traffic this interface handles, a lower bound of the real bus traffic.
+struct CANStats
+{
+    uint64_t tx_frames{0};
+    uint64_t rx_frames{0};
+    uint64_t tx_bytes{0};
+    uint64_t rx_bytes{0};
+    uint64_t tx_bits{0}; // on-wire bits, see CANInterface::frameBits
+    uint64_t rx_bits{0};
+    uint64_t tx_errors{0};    // failed write/sendmmsg
+    uint64_t bus_errors{0};   // CAN error frames reported by the controller
+    uint64_t tx_coalesced{0}; // setpoints replaced by a newer one before reaching the bus
+    uint64_t tx_dropped{0};   // frames lost to a full TX queue or a full socket/driver queue
+    uint64_t tx_blocked{0};   // writes cut short by a full socket/driver queue (tail retried)
+};
 
 class CANInterface
 {
 public:
+    using Frame = struct can_frame;
+
+    // Nominal bits of a standard data frame incl. interframe space, without bit stuffing
+    static constexpr uint32_t frameBits(uint8_t dlc) { return 47u + 8u * dlc; }
+
+    // Max frames handed to the kernel in one sendmmsg() call
+    static constexpr size_t MAX_BATCH = 16;
+    // Max frames drained per recvmmsg() call
+    static constexpr size_t RX_BATCH = 32;
+    // 6-bit ODrive node ID space
+    static constexpr size_t MAX_NODES = 64;
+    // Urgent frames the TX thread can hold before sendFrames() fails
+    static constexpr size_t TX_URGENT_CAPACITY = 256;
+    // TX thread wait for a full socket to drain before retrying the unsent tail
+    static constexpr int TX_BLOCKED_WAIT_MS = 10;
+    // Blocked retries after stopTransmitThread() before the rest of the queue is dropped
+    static constexpr int TX_STOP_RETRIES = 3;
+
+    enum class TxPriority : uint8_t
+    {
+        URGENT,   // axis state, clear errors, e-stop: FIFO, ahead of every setpoint
+        SETPOINT, // only the newest frame per CAN ID is kept until it reaches the bus
+    };
+
     CANInterface();
     ~CANInterface();
 
-    // Open a CAN interface
+    // Open a CAN interface (own-message echo is off unless enabled below)
     bool openInterface(const std::string &interface);
 
-    // Send a CAN frame
-    bool sendFrame(uint32_t frame_id, const std::vector<uint8_t> &data);
+    // Use an already open datagram socket instead of a CAN interface and take
+    // ownership of it, e.g. one end of a socketpair() in tests without SocketCAN.
+    // Frames are written as raw struct can_frame datagrams.
+    bool attachSocket(int fd, const std::string &name);
+
+    // Loop our own TX frames back into the RX path (CAN_RAW_RECV_OWN_MSGS)
+    bool setReceiveOwnMessages(bool enable);
+
+    // Install kernel-side CAN_RAW_FILTERs; an empty list blocks all RX
+    bool setFilters(std::span<const struct can_filter> filters);
 
-    // Register a callback for feedback
+    // Accept only (registered node, cmd_id) pairs, one exact-match filter each
+    bool applyNodeFilters(std::span<const uint8_t> cmd_ids);
+
+    // Send a CAN frame (payload up to 8 bytes, no heap allocation).
+    // With the TX thread running this only queues the frame; otherwise it is
+    // written from the calling thread.
+    bool sendFrame(uint32_t frame_id, std::span<const uint8_t> data,
+                   TxPriority priority = TxPriority::URGENT);
+
+    // Send several CAN frames, batched into sendmmsg() calls
+    bool sendFrames(std::span<const Frame> frames, TxPriority priority = TxPriority::URGENT);
+
+    // Register a callback for standard data frames with no node handler (call before startReceiveThread)
     void registerFeedbackCallback(FeedbackCallback cb);
 
-    // Receive loop for incoming CAN frames
-    void receiveLoop();
+    // O(1) RX dispatch by node ID; handler == nullptr unregisters
+    bool registerNode(uint8_t node_id, CANNodeHandler *handler);
+
+    // Managed RX thread: epoll on the socket + an eventfd used for shutdown
+    bool startReceiveThread();
+    void stopReceiveThread();
+
+    // Single TX thread owning the socket: drains urgent frames first, then the
+    // coalesced setpoints. stopTransmitThread() flushes what is still queued, or drops
+    // it after TX_STOP_RETRIES if the bus does not drain.
+    bool startTransmitThread();
+    void stopTransmitThread();
+    void setTransmitThreadConfig(const RtThreadConfig &config);
+    std::string describeTransmitThread();
+
+    // Priority/affinity applied by startReceiveThread() (set before starting it)
+    void setReceiveThreadConfig(const RtThreadConfig &config);
+    // Effective RX thread scheduling, "" when the thread is not running
+    std::string describeReceiveThread();
+
+    CANStats getStats() const;
+
+    // Start the background trace dumper (candump or binary log at `path`)
+    bool startTrace(const std::string &path, CANTrace::Format format = CANTrace::Format::CANDUMP);
+    void setTraceLevel(CANTrace::Level level);
 
 private:
+    void receiveLoop();
+    void transmitLoop();
+    void closeSocket();
+    // Writes until done or the socket refuses; returns frames sent, errno in `error`
+    size_t writeFrames(std::span<const Frame> frames, int &error);
+    void countUnsent(size_t count, int error);
+    void requeueUnsent(std::span<const Frame> batch, size_t urgent, size_t sent);
+    void waitWritable(int error);
+    static bool wouldBlock(int error) { return error == EAGAIN || error == EWOULDBLOCK || error == ENOBUFS; }
+
     int can_socket_;
+    int epoll_fd_{-1};
+    int stop_fd_{-1};
+    std::thread rx_thread_;
+    RtThreadConfig rx_config_;
+    std::string interface_name_;
     FeedbackCallback callback_;
+    std::array<std::atomic<CANNodeHandler *>, MAX_NODES> nodes_{};
+    CANTrace trace_;
+
+    // TX scheduler state, guarded by tx_mutex_
+    std::mutex tx_mutex_;
+    std::condition_variable tx_cv_;
+    std::thread tx_thread_;
+    RtThreadConfig tx_config_;
+    bool tx_running_{false};
+    bool tx_stop_{false};
+    std::array<Frame, TX_URGENT_CAPACITY> tx_urgent_;
+    size_t tx_urgent_head_{0};
+    size_t tx_urgent_count_{0};
+    std::array<Frame, CAN_SFF_MASK + 1> tx_latest_;   // newest setpoint per 11-bit ID
+    std::array<bool, CAN_SFF_MASK + 1> tx_pending_{}; // tx_latest_[id] not sent yet
+    std::array<uint16_t, CAN_SFF_MASK + 1> tx_order_; // pending IDs, oldest first
+    size_t tx_order_count_{0};
+
+    void countTx(const struct can_frame &frame);
+    std::atomic<uint64_t> tx_frames_{0}, rx_frames_{0};
+    std::atomic<uint64_t> tx_bytes_{0}, rx_bytes_{0};
+    std::atomic<uint64_t> tx_bits_{0}, rx_bits_{0};
+    std::atomic<uint64_t> tx_errors_{0}, bus_errors_{0};
+    std::atomic<uint64_t> tx_coalesced_{0}, tx_dropped_{0}, tx_blocked_{0};
 };
 
 #endif // CAN_COMM_HPP_
@@ -0,0 +1,85 @@
+#ifndef CAN_LOG_HPP_
+#define CAN_LOG_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Binary CAN log written by CANTrace (Format::BINARY) and read back by the
+// replayer. A 64-byte header is followed by fixed-size records in
+// non-decreasing timestamp order, so a mapped file can be binary-searched by
+// time. There is no footer: a log cut short by a crash stays readable up to
+// the last complete record.
+//
+// Timestamps: every record is on CLOCK_MONOTONIC. TX records carry the time
+// sendmmsg() returned. RX records carry the controller's hardware timestamp
+// (SO_TIMESTAMPING ts[2]) when the driver provides one, flagged with
+// FLAG_HW_TIMESTAMP, otherwise the kernel software receive time (ts[0]).
+// Hardware stamps come from the controller's oscillator, which most CAN
+// drivers (gs_usb, mcp251xfd, ...) align to CLOCK_REALTIME when they start;
+// they are mapped onto the monotonic timeline with the same offset and can
+// drift from it by a few ppm. Drivers without hardware stamping (vcan,
+// slcan, ...) give software stamps only. Which source a record used is
+// per-frame, hence a record flag rather than a header field.
+
+struct CANLogHeader
+{
+    static constexpr char MAGIC[8] = {'O', 'D', 'C', 'A', 'N', 'L', 'O', 'G'};
+    static constexpr uint32_t VERSION = 1;
+
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    uint64_t start_realtime_ns;  // wall clock when recording started, to line up with match notes
+    uint64_t start_monotonic_ns; // CLOCK_MONOTONIC at the same instant
+    char interface[32];
+};
+static_assert(sizeof(CANLogHeader) == 64, "CANLogHeader layout is part of the file format");
+
+struct CANLogRecord
+{
+    static constexpr uint8_t FLAG_TX = 0x01;        // sent by us (otherwise received)
+    static constexpr uint8_t FLAG_REORDERED = 0x02; // arrived after newer frames; timestamp raised to keep order
+    static constexpr uint8_t FLAG_HW_TIMESTAMP = 0x04; // timestamp_ns from the CAN controller, not the kernel
+
+    uint64_t timestamp_ns; // CLOCK_MONOTONIC; RX frames carry the hardware or kernel timestamp
+    uint32_t can_id;       // as in struct can_frame, including EFF/RTR/ERR flags
+    uint8_t dlc;
+    uint8_t flags;
+    uint8_t reserved[2];
+    uint8_t data[8];
+
+    bool isTx() const { return flags & FLAG_TX; }
+};
+static_assert(sizeof(CANLogRecord) == 24, "CANLogRecord layout is part of the file format");
+
+// Read-only mmap view of a binary CAN log
+class CANLogReader
+{
+public:
+    CANLogReader() = default;
+    ~CANLogReader();
+    CANLogReader(const CANLogReader &) = delete;
+    CANLogReader &operator=(const CANLogReader &) = delete;
+
+    bool open(const std::string &path, std::string &error);
+    void close();
+
+    const CANLogHeader &header() const { return *header_; }
+    size_t size() const { return count_; }
+    const CANLogRecord &operator[](size_t i) const { return records_[i]; }
+    const CANLogRecord *begin() const { return records_; }
+    const CANLogRecord *end() const { return records_ + count_; }
+
+    // Index of the first record with timestamp >= timestamp_ns (size() if none)
+    size_t lowerBound(uint64_t timestamp_ns) const;
+
+private:
+    void *map_{nullptr};
+    size_t map_size_{0};
+    const CANLogHeader *header_{nullptr};
+    const CANLogRecord *records_{nullptr};
+    size_t count_{0};
+};
+
+#endif // CAN_LOG_HPP_
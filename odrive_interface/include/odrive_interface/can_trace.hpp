@@ -0,0 +1,105 @@
+#ifndef CAN_TRACE_HPP_
+#define CAN_TRACE_HPP_
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+#include <linux/can.h>
+
+// Lock-free in-memory trace of TX/RX CAN frames.
+// record() is wait-free for the caller apart from a CAS on the write index;
+// a background dumper drains the ring into a candump-compatible log file or
+// a binary, time-ordered log (can_log.hpp) for replay.
+class CANTrace
+{
+public:
+    enum class Level : int
+    {
+        OFF = 0,     // nothing recorded (default)
+        RECORD = 1,  // TX/RX frames written to the log file
+        CONSOLE = 2, // also echoed to stdout by the dumper thread
+    };
+
+    enum class Format : int
+    {
+        CANDUMP, // text, candump -l compatible: wall-clock time, no TX/RX direction
+        BINARY,  // CANLogHeader + CANLogRecord[], see can_log.hpp
+    };
+
+    enum class Direction : uint8_t
+    {
+        TX,
+        RX
+    };
+
+    struct Entry
+    {
+        uint64_t timestamp_ns; // CLOCK_MONOTONIC
+        struct can_frame frame;
+        Direction dir;
+        bool hw_timestamp; // timestamp_ns from the CAN controller, see can_log.hpp
+    };
+
+    static constexpr size_t CAPACITY = 4096; // power of two
+    // BINARY: frames are held this long and sorted before writing, so RX kernel
+    // timestamps that trail a TX frame still land in time order
+    static constexpr uint64_t REORDER_WINDOW_NS = 50'000'000;
+
+    CANTrace();
+    ~CANTrace();
+
+    // Start the dumper thread writing to `path` (empty = no file)
+    bool start(const std::string &path, const std::string &interface, Format format = Format::CANDUMP);
+    void stop();
+
+    void setLevel(Level level) { level_.store(level, std::memory_order_relaxed); }
+    Level getLevel() const { return level_.load(std::memory_order_relaxed); }
+    bool enabled() const { return getLevel() != Level::OFF; }
+
+    // Hot path: a few stores into the ring; drops the frame if the ring is full
+    void record(Direction dir, const struct can_frame &frame);
+    void record(Direction dir, const struct can_frame &frame, uint64_t timestamp_ns,
+                bool hw_timestamp = false);
+
+    uint64_t droppedCount() const { return dropped_.load(std::memory_order_relaxed); }
+
+    static uint64_t monotonicNs();
+
+private:
+    struct Slot
+    {
+        std::atomic<uint64_t> seq;
+        Entry entry;
+    };
+
+    static constexpr uint64_t MASK = CAPACITY - 1;
+    static_assert((CAPACITY & MASK) == 0, "CAPACITY must be a power of two");
+
+    bool pop(Entry &out);
+    void dumpLoop();
+    void writeEntry(const Entry &e);
+    bool writeBinaryHeader();
+    // Write held-back entries older than the reorder window (all if flush_all)
+    void writeBinary(bool flush_all);
+
+    std::array<Slot, CAPACITY> slots_;
+    alignas(64) std::atomic<uint64_t> head_{0};
+    alignas(64) uint64_t tail_{0};
+    std::atomic<uint64_t> dropped_{0};
+    std::atomic<Level> level_{Level::OFF};
+
+    std::atomic<bool> running_{false};
+    std::thread dumper_;
+    FILE *file_{nullptr};
+    std::string interface_;
+    Format format_{Format::CANDUMP};
+    std::vector<Entry> pending_; // BINARY, dumper thread only
+    uint64_t last_written_ns_{0};
+    int64_t realtime_offset_ns_{0}; // CLOCK_REALTIME - CLOCK_MONOTONIC, taken by start()
+};
+
+#endif // CAN_TRACE_HPP_
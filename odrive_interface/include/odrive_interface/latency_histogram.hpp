@@ -0,0 +1,83 @@
+#ifndef LATENCY_HISTOGRAM_HPP_
+#define LATENCY_HISTOGRAM_HPP_
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+// Lock-free log2 histogram of latencies in microseconds.
+// Bucket i holds samples in [2^(i-1), 2^i) us; bucket 0 holds < 1 us.
+class LatencyHistogram
+{
+public:
+    static constexpr size_t BUCKETS = 24; // up to ~8 s
+
+    struct Snapshot
+    {
+        std::array<uint64_t, BUCKETS> counts{};
+        uint64_t count{0};
+        uint64_t max_us{0};
+        uint64_t sum_us{0};
+
+        // Upper bound of the bucket holding the q-quantile (q in [0, 1])
+        uint64_t percentileUs(double q) const
+        {
+            if (count == 0)
+                return 0;
+            const uint64_t rank = static_cast<uint64_t>(q * static_cast<double>(count - 1)) + 1;
+            uint64_t seen = 0;
+            for (size_t i = 0; i < BUCKETS; ++i)
+            {
+                seen += counts[i];
+                if (seen >= rank)
+                    return i == 0 ? 1 : (uint64_t{1} << i);
+            }
+            return max_us;
+        }
+
+        double meanUs() const { return count ? static_cast<double>(sum_us) / static_cast<double>(count) : 0.0; }
+    };
+
+    void record(uint64_t latency_ns)
+    {
+        const uint64_t us = latency_ns / 1000;
+        size_t bucket = 0;
+        while (bucket + 1 < BUCKETS && (uint64_t{1} << bucket) <= us)
+            ++bucket;
+        counts_[bucket].fetch_add(1, std::memory_order_relaxed);
+        count_.fetch_add(1, std::memory_order_relaxed);
+        sum_us_.fetch_add(us, std::memory_order_relaxed);
+        uint64_t prev = max_us_.load(std::memory_order_relaxed);
+        while (us > prev && !max_us_.compare_exchange_weak(prev, us, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    Snapshot snapshot() const
+    {
+        Snapshot s;
+        for (size_t i = 0; i < BUCKETS; ++i)
+            s.counts[i] = counts_[i].load(std::memory_order_relaxed);
+        s.count = count_.load(std::memory_order_relaxed);
+        s.max_us = max_us_.load(std::memory_order_relaxed);
+        s.sum_us = sum_us_.load(std::memory_order_relaxed);
+        return s;
+    }
+
+    void reset()
+    {
+        for (auto &c : counts_)
+            c.store(0, std::memory_order_relaxed);
+        count_.store(0, std::memory_order_relaxed);
+        max_us_.store(0, std::memory_order_relaxed);
+        sum_us_.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    std::array<std::atomic<uint64_t>, BUCKETS> counts_{};
+    std::atomic<uint64_t> count_{0};
+    std::atomic<uint64_t> max_us_{0};
+    std::atomic<uint64_t> sum_us_{0};
+};
+
+#endif // LATENCY_HISTOGRAM_HPP_
@@ -0,0 +1,161 @@
+#ifndef MOTION_EXECUTOR_HPP_
+#define MOTION_EXECUTOR_HPP_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "rt_thread.hpp"
+
+// Hashed timer wheel. Deadlines are kept exactly; the tick only picks the bucket.
+// Not thread safe: owned by the MotionExecutor thread.
+class TimerWheel
+{
+public:
+    using Clock = std::chrono::steady_clock;
+    using Callback = std::function<void()>;
+
+    TimerWheel(Clock::duration tick, size_t slots);
+
+    // `id` must be unique among pending timers
+    void add(uint64_t id, Clock::time_point deadline, Callback cb);
+    bool cancel(uint64_t id);
+
+    // Move callbacks whose deadline is <= now into `out`, in deadline order
+    void expire(Clock::time_point now, std::vector<Callback> &out);
+
+    std::optional<Clock::time_point> nextDeadline() const;
+    bool empty() const { return index_.empty(); }
+
+private:
+    struct Entry
+    {
+        uint64_t id;
+        Clock::time_point deadline;
+        Callback cb;
+    };
+
+    size_t slotOf(Clock::time_point t) const;
+
+    Clock::duration tick_;
+    std::vector<std::vector<Entry>> slots_;
+    std::unordered_map<uint64_t, size_t> index_; // timer id -> slot
+    Clock::time_point origin_;
+    int64_t last_tick_{0};
+};
+
+// Single-threaded executor for timed motion scripts.
+// All scripts, timers and posted work run on one thread, in order, so motor
+// commands from different sequences never interleave.
+class MotionExecutor
+{
+public:
+    using Clock = TimerWheel::Clock;
+
+    struct Step
+    {
+        Clock::duration delay{0};       // after the previous step completed
+        std::function<void()> action;   // may be empty
+        std::function<bool()> until;    // optional: hold the script until true
+        Clock::duration timeout{0};     // limit for `until` (0 = no limit)
+        std::function<void()> on_timeout;
+        bool continue_on_timeout{false}; // run on_timeout, then go on with the next step
+    };
+
+    struct Script
+    {
+        std::string name;
+        uint32_t groups{0}; // caller-defined bitmask of what the script commands, see cancelIf()
+        std::vector<Step> steps;
+        std::function<void()> on_cancel; // pre-empted or cancelled mid-way
+        std::function<void()> on_done;
+    };
+
+    enum class Policy
+    {
+        PREEMPT,      // cancel the running script and the queue, start now
+        QUEUE,        // run after the scripts already queued
+        DROP_IF_BUSY, // ignore while another script runs
+    };
+
+    MotionExecutor();
+    ~MotionExecutor();
+
+    void start();
+    void stop();
+
+    // Priority/affinity applied by start() (set before starting)
+    void setThreadConfig(const RtThreadConfig &config) { config_ = config; }
+    // Effective executor thread scheduling, "" when not running
+    std::string describeThread();
+
+    // Applied at once on the executor thread, posted from any other thread
+    void submit(Script script, Policy policy);
+    void cancelAll();
+    // Cancel the running and queued scripts matching `pred` (their on_cancel runs),
+    // leave the others running
+    void cancelIf(std::function<bool(const Script &)> pred);
+
+    // Run `fn` on the executor thread
+    void post(std::function<void()> fn);
+
+    // Re-evaluate the waiting step's `until` now (e.g. from the CAN RX thread).
+    // Call after publishing the new state; posts nothing when no step waits.
+    void notify();
+
+    // One-shot timer on the executor thread; returns an id for cancelTimer
+    uint64_t schedule(Clock::duration delay, std::function<void()> fn);
+    void cancelTimer(uint64_t id);
+
+    bool busy() const { return busy_.load(std::memory_order_relaxed); }
+    bool onExecutorThread() const { return std::this_thread::get_id() == thread_.get_id(); }
+
+private:
+    static constexpr auto WAIT_POLL = std::chrono::milliseconds(20);
+
+    void loop();
+    uint64_t addTimer(Clock::time_point deadline, std::function<void()> fn);
+
+    // Executor-thread only
+    void applySubmit(Script script, Policy policy);
+    void startScript(Script script);
+    void scheduleStep(Clock::time_point base);
+    void onStepDue(uint64_t gen);
+    void checkWait(uint64_t gen);
+    void onWaitTimeout(uint64_t gen, uint64_t wait);
+    void cancelActive();
+    void finishActive();
+    void clearTimers();
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::vector<std::function<void()>> inbox_;
+    bool stop_{false};
+    std::thread thread_;
+    RtThreadConfig config_;
+
+    TimerWheel wheel_;
+    std::atomic<uint64_t> next_timer_id_{1};
+    std::optional<Script> active_;
+    std::deque<Script> queue_;
+    size_t index_{0};
+    uint64_t generation_{0};
+    Clock::time_point step_due_{};
+    uint64_t step_timer_{0};
+    uint64_t wait_timer_{0};
+    uint64_t poll_timer_{0};
+    std::atomic<bool> waiting_{false}; // written by the executor thread, read by notify()
+    uint64_t wait_seq_{0}; // bumped per until-wait, ties a timeout to its own wait
+    std::atomic<bool> notify_pending_{false};
+    std::atomic<bool> busy_{false};
+};
+
+#endif // MOTION_EXECUTOR_HPP_
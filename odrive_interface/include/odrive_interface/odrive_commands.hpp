@@ -0,0 +1,180 @@
+#ifndef ODRIVE_COMMANDS_HPP_
+#define ODRIVE_COMMANDS_HPP_
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+
+// Typed ODrive CAN commands. Each struct knows its command ID and payload
+// length at compile time; pack() writes the fields at fixed little-endian
+// offsets, so encoding is a handful of stores into an 8-byte array.
+namespace odrive
+{
+static_assert(std::endian::native == std::endian::little, "ODrive CAN payloads are little-endian");
+
+enum class ControlMode : uint32_t
+{
+    VOLTAGE = 0,
+    TORQUE = 1,
+    VELOCITY = 2,
+    POSITION = 3,
+};
+
+enum class InputMode : uint32_t
+{
+    INACTIVE = 0,
+    PASSTHROUGH = 1,
+    VEL_RAMP = 2,
+    POS_FILTER = 3,
+    MIX_CHANNELS = 4,
+    TRAP_TRAJ = 5,
+    TORQUE_RAMP = 6,
+    MIRROR = 7,
+    TUNING = 8,
+};
+
+// Fixed-size payload with compile-time field offsets
+template <size_t N>
+struct Payload
+{
+    static_assert(N <= 8, "classic CAN payload is at most 8 bytes");
+    std::array<uint8_t, N> bytes{};
+
+    template <size_t OFFSET, typename T>
+    constexpr void put(T value)
+    {
+        static_assert(OFFSET + sizeof(T) <= N, "field overruns the payload");
+        const auto raw = std::bit_cast<std::array<uint8_t, sizeof(T)>>(value);
+        for (size_t i = 0; i < sizeof(T); ++i)
+            bytes[OFFSET + i] = raw[i];
+    }
+};
+
+// Feed-forward terms in Set_Input_Pos are int16 in units of 0.001
+constexpr int16_t toFixed16(float value)
+{
+    const float scaled = value * 1000.0f;
+    const float clamped = std::clamp(scaled, -32768.0f, 32767.0f);
+    return static_cast<int16_t>(clamped < 0.0f ? clamped - 0.5f : clamped + 0.5f);
+}
+
+struct SetAxisState
+{
+    static constexpr uint8_t CMD_ID = 0x07;
+    static constexpr size_t DLC = 4;
+    uint32_t state;
+
+    constexpr std::array<uint8_t, DLC> pack() const
+    {
+        Payload<DLC> p;
+        p.put<0>(state);
+        return p.bytes;
+    }
+};
+
+struct SetControllerMode
+{
+    static constexpr uint8_t CMD_ID = 0x0B;
+    static constexpr size_t DLC = 8;
+    ControlMode control_mode;
+    InputMode input_mode;
+
+    constexpr std::array<uint8_t, DLC> pack() const
+    {
+        Payload<DLC> p;
+        p.put<0>(static_cast<uint32_t>(control_mode));
+        p.put<4>(static_cast<uint32_t>(input_mode));
+        return p.bytes;
+    }
+};
+
+// Position setpoint [turn] with velocity [turn/s] and torque [Nm] feed-forward
+struct SetInputPos
+{
+    static constexpr uint8_t CMD_ID = 0x0C;
+    static constexpr size_t DLC = 8;
+    float position;
+    float vel_ff{0.0f};
+    float torque_ff{0.0f};
+
+    constexpr std::array<uint8_t, DLC> pack() const
+    {
+        Payload<DLC> p;
+        p.put<0>(position);
+        p.put<4>(toFixed16(vel_ff));
+        p.put<6>(toFixed16(torque_ff));
+        return p.bytes;
+    }
+};
+
+// Velocity setpoint [turn/s] with torque [Nm] feed-forward
+struct SetInputVel
+{
+    static constexpr uint8_t CMD_ID = 0x0D;
+    static constexpr size_t DLC = 8;
+    float velocity;
+    float torque_ff{0.0f};
+
+    constexpr std::array<uint8_t, DLC> pack() const
+    {
+        Payload<DLC> p;
+        p.put<0>(velocity);
+        p.put<4>(torque_ff);
+        return p.bytes;
+    }
+};
+
+struct SetInputTorque
+{
+    static constexpr uint8_t CMD_ID = 0x0E;
+    static constexpr size_t DLC = 4;
+    float torque;
+
+    constexpr std::array<uint8_t, DLC> pack() const
+    {
+        Payload<DLC> p;
+        p.put<0>(torque);
+        return p.bytes;
+    }
+};
+
+// Velocity limit [turn/s] and current limit [A]
+struct SetLimits
+{
+    static constexpr uint8_t CMD_ID = 0x0F;
+    static constexpr size_t DLC = 8;
+    float velocity_limit;
+    float current_limit;
+
+    constexpr std::array<uint8_t, DLC> pack() const
+    {
+        Payload<DLC> p;
+        p.put<0>(velocity_limit);
+        p.put<4>(current_limit);
+        return p.bytes;
+    }
+};
+
+struct ClearErrors
+{
+    static constexpr uint8_t CMD_ID = 0x18;
+    static constexpr size_t DLC = 1;
+    uint8_t identify{0};
+
+    constexpr std::array<uint8_t, DLC> pack() const
+    {
+        Payload<DLC> p;
+        p.put<0>(identify);
+        return p.bytes;
+    }
+};
+
+// Layout checks, evaluated by the compiler
+static_assert(SetInputVel{1.0f, 0.0f}.pack() == std::array<uint8_t, 8>{0x00, 0x00, 0x80, 0x3F, 0, 0, 0, 0});
+static_assert(SetInputPos{0.0f, 1.0f, -1.0f}.pack() == std::array<uint8_t, 8>{0, 0, 0, 0, 0xE8, 0x03, 0x18, 0xFC});
+static_assert(SetAxisState{8}.pack() == std::array<uint8_t, 4>{0x08, 0, 0, 0});
+} // namespace odrive
+
+#endif // ODRIVE_COMMANDS_HPP_
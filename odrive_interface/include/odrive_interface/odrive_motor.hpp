@@ -1,11 +1,17 @@
 #ifndef ODRIVE_MOTOR_HPP_
 #define ODRIVE_MOTOR_HPP_
 
+#include <array>
+#include <atomic>
+#include <functional>
 #include <cstdint>
-#include <vector>
+#include <cstring>
+#include <span>
 #include "can_comm.hpp"
+#include "latency_histogram.hpp"
+#include "odrive_commands.hpp"
 
-class OdriveMotor
+class OdriveMotor : public CANNodeHandler
 {
 public:
     enum ControlMode
@@ -15,20 +21,120 @@ public:
         TORQUE
     };
 
+    static constexpr uint8_t HEARTBEAT_CMD_ID = 0x01;
+    static constexpr uint8_t ERROR_CMD_ID = 0x03;
     static constexpr uint8_t FEEDBACK_CMD_ID = 0x09;
 
+    // Axis states (Set_Axis_State / heartbeat)
+    static constexpr uint8_t AXIS_STATE_UNDEFINED = 0x00;
+    static constexpr uint8_t AXIS_STATE_IDLE = 0x01;
+    static constexpr uint8_t AXIS_STATE_FULL_CALIBRATION = 0x03;
+    static constexpr uint8_t AXIS_STATE_CLOSED_LOOP = 0x08;
+    static constexpr uint8_t AXIS_STATE_HOMING = 0x0B;
+
+    // Command IDs the RX path consumes; used to build kernel CAN filters
+    static constexpr std::array<uint8_t, 3> RX_CMD_IDS = {HEARTBEAT_CMD_ID, ERROR_CMD_ID, FEEDBACK_CMD_ID};
+
+    // Encoder estimate snapshot; timestamp_ns is the CAN RX time (CLOCK_MONOTONIC, 0 = never)
+    struct Feedback
+    {
+        float position;
+        float velocity;
+        uint64_t timestamp_ns;
+
+        uint64_t ageNs(uint64_t now_ns) const { return timestamp_ns ? now_ns - timestamp_ns : UINT64_MAX; }
+    };
+
+    // Latest heartbeat (0x01) and Get_Error (0x03) report.
+    // *_ns are CAN RX times (CLOCK_MONOTONIC), 0 = not received yet.
+    struct Health
+    {
+        uint8_t axis_state;
+        uint32_t axis_error;
+        uint8_t procedure_result;
+        bool trajectory_done;
+        uint32_t active_errors;
+        uint32_t disarm_reason;
+        uint64_t heartbeat_ns;
+        uint64_t error_ns;
+
+        uint64_t heartbeatAgeNs(uint64_t now_ns) const { return heartbeat_ns ? now_ns - heartbeat_ns : UINT64_MAX; }
+        bool closedLoop() const { return axis_state == AXIS_STATE_CLOSED_LOOP; }
+        bool faulted() const { return axis_error != 0 || active_errors != 0; }
+    };
+
+    // Standard 11-bit ODrive frame ID: node_id << 5 | cmd_id
+    static constexpr uint32_t computeFrameId(uint8_t node_id, uint8_t cmd_id)
+    {
+        return ((static_cast<uint32_t>(node_id) << 5) | cmd_id) & CAN_SFF_MASK;
+    }
+
     OdriveMotor(uint8_t device_id, ControlMode mode, CANInterface *can_interface);
-    ~OdriveMotor();
+    ~OdriveMotor() override;
+    OdriveMotor(const OdriveMotor &) = delete;
+    OdriveMotor &operator=(const OdriveMotor &) = delete;
 
     bool fullCalibration();      // cmd 0x07, data=0x03
     bool idle();                 // cmd 0x07, data=0x01
     bool closeLoopControl();     // cmd 0x07, data=0x08
     bool clearError();           // cmd 0x18, data=0x00
     bool setHoming();            // cmd 0x07, data=0x0B
-    bool setTarget(float value); // cmd based on mode
+    bool setTarget(float value); // Set_Input_Vel/Pos/Torque depending on mode
+
+    // Setpoints with feed-forward (coalesced on the TX queue)
+    bool setVelocity(float velocity, float torque_ff = 0.0f);                      // cmd 0x0D
+    bool setPosition(float position, float vel_ff = 0.0f, float torque_ff = 0.0f); // cmd 0x0C
+    bool setTorque(float torque);                                                  // cmd 0x0E
+
+    // Configuration
+    bool setLimits(float velocity_limit, float current_limit);                       // cmd 0x0F
+    bool setControllerMode(odrive::ControlMode control, odrive::InputMode input); // cmd 0x0B
+
+    // Send any command from odrive_commands.hpp to this node
+    template <typename Cmd>
+    bool send(const Cmd &cmd, CANInterface::TxPriority priority = CANInterface::TxPriority::URGENT)
+    {
+        return sendCommand(Cmd::CMD_ID, cmd.pack(), priority);
+    }
+
+    // Group commands: one frame per motor, one sendmmsg() per CAN bus involved
+    static bool setTargets(std::span<OdriveMotor *const> motors, std::span<const float> values);
+    static bool setVelocities(std::span<OdriveMotor *const> motors, std::span<const float> velocities,
+                              std::span<const float> torque_ffs);
+    static bool idleGroup(std::span<OdriveMotor *const> motors);
+    static bool closeLoopControlGroup(std::span<OdriveMotor *const> motors);
+    static bool clearErrorGroup(std::span<OdriveMotor *const> motors);
 
     uint8_t getDeviceId() const;
-    void setFeedback(float pos, float vel);
+    ControlMode getControlMode() const { return mode_; }
+
+    // Single writer (the CAN RX thread); readers never block it
+    void setFeedback(float pos, float vel, uint64_t timestamp_ns);
+    void onFrame(uint8_t cmd_id, const uint8_t *data, uint8_t len, uint64_t timestamp_ns) override;
+    // Arms the latency probe when a setpoint step leaves the socket
+    void onTransmit(uint8_t cmd_id, const uint8_t *data, uint8_t len, uint64_t timestamp_ns) override;
+
+    // Torn-free position/velocity/timestamp snapshot (seqlock read)
+    Feedback getFeedback() const;
+
+    // Called on the RX thread after each feedback update (set before RX starts)
+    void setFeedbackListener(std::function<void()> listener);
+
+    // Torn-free per frame: each report is one 64-bit word
+    Health getHealth() const;
+
+    // Called on the RX thread when a heartbeat or error report differs from the
+    // previous one (state change, new error flags); must not block. Set before RX starts.
+    void setHealthListener(std::function<void(const Health &)> listener);
+
+    // Setpoint step handed to the socket -> first encoder feedback within
+    // tolerance of it. Velocity and position modes only; a step that is not
+    // reached within LATENCY_TIMEOUT_NS (limits, ramps) is dropped.
+    LatencyHistogram::Snapshot getLatency() const { return latency_.snapshot(); }
+
+    static constexpr float LATENCY_ABS_TOLERANCE = 0.05f; // turns/s or turns
+    static constexpr float LATENCY_REL_TOLERANCE = 0.02f; // of |target|
+    static constexpr uint64_t LATENCY_TIMEOUT_NS = 1000000000ull;
 
     float getVelocity() const;
     float getPosition() const;
@@ -38,12 +144,54 @@ private:
     ControlMode mode_;
     CANInterface *can_interface_;
 
-    float velocity_{0.0f};
-    float position_{0.0f};
+    // Seqlock: odd sequence = write in progress
+    std::atomic<uint32_t> fb_seq_{0};
+    std::atomic<float> velocity_{0.0f};
+    std::atomic<float> position_{0.0f};
+    std::atomic<uint64_t> fb_timestamp_ns_{0};
+
+    std::function<void()> feedback_listener_;
+
+    // Heartbeat: axis_error | state << 32 | procedure_result << 40 | traj_done << 48
+    // Error: active_errors | disarm_reason << 32; UINT64_MAX until the first frame
+    std::atomic<uint64_t> heartbeat_word_;
+    std::atomic<uint64_t> heartbeat_ns_{0};
+    std::atomic<uint64_t> error_word_;
+    std::atomic<uint64_t> error_ns_{0};
+    std::function<void(const Health &)> health_listener_;
+
+    // Latency probe: TX time of a setpoint step (CLOCK_MONOTONIC ns, 0 = none)
+    // and its value. Written by the sending thread only while 0, cleared by RX.
+    std::atomic<uint64_t> pending_cmd_ns_{0};
+    std::atomic<float> pending_target_{0.0f};
+    LatencyHistogram latency_;
+    bool reachedTarget(float position, float velocity, float target) const;
+
+    CANInterface::Frame makeFrame(uint8_t cmd_id, std::span<const uint8_t> data) const;
+    template <typename Cmd>
+    CANInterface::Frame makeFrame(const Cmd &cmd) const
+    {
+        return makeFrame(Cmd::CMD_ID, cmd.pack());
+    }
+    // Mode-dependent setpoint frame without feed-forward
+    CANInterface::Frame targetFrame(float value) const;
+
+    template <typename Cmd>
+    bool sendSetpoint(const Cmd &cmd)
+    {
+        return send(cmd, CANInterface::TxPriority::SETPOINT);
+    }
+    // Axis-state/clear-error commands are URGENT; setpoints coalesce per motor
+    bool sendCommand(uint8_t cmd_id, std::span<const uint8_t> data,
+                     CANInterface::TxPriority priority = CANInterface::TxPriority::URGENT);
+    bool sendAxisState(uint32_t state);
+
+    // Distinct buses batched at once by sendGroup(); more buses flush early
+    static constexpr size_t MAX_GROUP_BUSES = 4;
 
-    uint32_t computeFrameId(uint8_t cmd_id);
-    bool sendCommand(uint8_t cmd_id, const std::vector<uint8_t> &data);
-    std::vector<uint8_t> floatToBytes(float value);
+    template <typename BuildFrame>
+    static bool sendGroup(std::span<OdriveMotor *const> motors, BuildFrame build,
+                          CANInterface::TxPriority priority = CANInterface::TxPriority::URGENT);
 };
 
 #endif // ODRIVE_MOTOR_HPP_
@@ -0,0 +1,30 @@
+#ifndef RT_THREAD_HPP_
+#define RT_THREAD_HPP_
+
+#include <pthread.h>
+#include <string>
+#include <vector>
+
+// Scheduling settings for one I/O thread
+struct RtThreadConfig
+{
+    int priority{0};            // SCHED_FIFO priority 1..99, 0 = stay on SCHED_OTHER
+    std::vector<int> cpus;      // CPU affinity, empty = any CPU
+    bool prefault_stack{false}; // touch the stack at thread start (use with lockMemory)
+};
+
+// Apply `cfg` to a running thread. On failure (usually EPERM without
+// CAP_SYS_NICE / rtprio limits) `error` explains why; the thread keeps running.
+bool applyRtConfig(pthread_t thread, const RtThreadConfig &cfg, std::string &error);
+
+// mlockall(MCL_CURRENT | MCL_FUTURE) so page faults cannot stall I/O threads
+bool lockMemory(std::string &error);
+
+// Commit PREFAULT_STACK_BYTES of the calling thread's stack
+void prefaultStack();
+constexpr size_t PREFAULT_STACK_BYTES = 64 * 1024;
+
+// Effective policy/priority/affinity, e.g. "SCHED_FIFO/80 cpus=2,3"
+std::string describeThread(pthread_t thread);
+
+#endif // RT_THREAD_HPP_
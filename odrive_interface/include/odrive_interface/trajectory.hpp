@@ -0,0 +1,89 @@
+#ifndef TRAJECTORY_HPP_
+#define TRAJECTORY_HPP_
+
+#include <cstdint>
+#include <span>
+#include <vector>
+#include "motion_executor.hpp"
+#include "odrive_motor.hpp"
+
+// Online time-optimal profile for one scalar setpoint. step() moves the output
+// toward the target within the limits; the target may change at any time.
+//   rate only             -> linear ramp
+//   rate + rate_change    -> trapezoidal position, or jerk-limited (S-curve) velocity
+// For a velocity axis pass {max_accel, max_jerk}; for a position axis {max_vel, max_accel}.
+class SetpointProfile
+{
+public:
+    struct Limits
+    {
+        float rate{0.0f};        // |d(value)/dt|, 0 = unlimited (jump to target)
+        float rate_change{0.0f}; // |d2(value)/dt2|, 0 = ramp at `rate`
+    };
+
+    SetpointProfile() = default;
+    explicit SetpointProfile(Limits limits) : limits_(limits) {}
+
+    void reset(float value);
+    void setTarget(float target) { target_ = target; }
+    void setLimits(Limits limits) { limits_ = limits; }
+
+    // Advance by dt seconds; returns true once the output sits on the target
+    bool step(float dt);
+
+    float value() const { return value_; }
+    float rate() const { return rate_; }
+    float target() const { return target_; }
+    bool done() const { return value_ == target_ && rate_ == 0.0f; }
+
+private:
+    Limits limits_;
+    float value_{0.0f};
+    float rate_{0.0f};
+    float target_{0.0f};
+};
+
+// Streams profiled setpoints for a motor group at a fixed rate on the
+// MotionExecutor thread. All methods must be called on that thread, or after
+// the executor has stopped (shutdown).
+class TrajectoryStreamer
+{
+public:
+    TrajectoryStreamer(MotionExecutor &executor, std::vector<OdriveMotor *> motors,
+                       SetpointProfile::Limits limits, double rate_hz);
+
+    // Start or retarget the profile; one value per motor
+    void setTargets(std::span<const float> targets);
+    // Velocity axes: send torque feed-forward = gain * profiled acceleration
+    // (gain in Nm per turn/s^2, i.e. the reflected inertia; 0 = off)
+    void setTorqueFeedForward(float gain) { torque_ff_gain_ = gain; }
+
+    // Stop streaming where the profile is now
+    void stop();
+    // Stop streaming and send the current profiled setpoint once more,
+    // never the target (a ramp cut short must not become a step)
+    void hold();
+
+    bool active() const { return running_; }
+
+private:
+    using Clock = MotionExecutor::Clock;
+
+    void tick(uint64_t gen);
+    void sendSetpoints();
+
+    MotionExecutor &executor_;
+    std::vector<OdriveMotor *> motors_;
+    std::vector<SetpointProfile> profiles_;
+    std::vector<float> out_;
+    std::vector<float> torque_ff_;
+    float torque_ff_gain_{0.0f};
+    bool unlimited_;
+    Clock::duration period_;
+    Clock::time_point last_tick_{};
+    uint64_t timer_{0};
+    uint64_t generation_{0};
+    bool running_{false};
+};
+
+#endif // TRAJECTORY_HPP_
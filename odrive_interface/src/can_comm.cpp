@@ -1,23 +1,42 @@
 #include "odrive_interface/can_comm.hpp"
+#include <algorithm>
+#include <vector>
+#include <ctime>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <linux/errqueue.h>
+#include <linux/net_tstamp.h>
+#include <linux/sockios.h>
+#include <linux/can/error.h>
 
 CANInterface::CANInterface() : can_socket_(-1) {}
 
 CANInterface::~CANInterface()
+{
+    stopTransmitThread();
+    stopReceiveThread();
+    closeSocket();
+}
+
+void CANInterface::closeSocket()
 {
     if (can_socket_ >= 0)
     {
         close(can_socket_);
+        can_socket_ = -1;
     }
 }
 
 bool CANInterface::openInterface(const std::string &interface)
 {
-    if (can_socket_ >= 0)
-    {
-        close(can_socket_);
-    }
+    stopTransmitThread();
+    stopReceiveThread();
+    closeSocket();
 
-    can_socket_ = socket(PF_CAN, SOCK_RAW, CAN_RAW);
+    // Non-blocking: a full driver queue must not stall the caller or the TX thread
+    can_socket_ = socket(PF_CAN, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC, CAN_RAW);
     if (can_socket_ < 0)
     {
         std::cerr << "Error: could not create CAN socket." << std::endl;
@@ -46,27 +65,59 @@ bool CANInterface::openInterface(const std::string &interface)
         return false;
     }
 
-    int recv_own = 1;
-    if (setsockopt(can_socket_, SOL_CAN_RAW,
-                   CAN_RAW_RECV_OWN_MSGS,
-                   &recv_own, sizeof(recv_own)) < 0)
+    setReceiveOwnMessages(false);
+
+    // Deliver controller error frames so bus errors show up in the stats
+    can_err_mask_t err_mask = CAN_ERR_TX_TIMEOUT | CAN_ERR_CRTL | CAN_ERR_PROT |
+                              CAN_ERR_BUSOFF | CAN_ERR_BUSERROR;
+    if (setsockopt(can_socket_, SOL_CAN_RAW, CAN_RAW_ERR_FILTER, &err_mask, sizeof(err_mask)) < 0)
+    {
+        std::cerr << "Warning: cannot set CAN_RAW_ERR_FILTER\n";
+    }
+
+    // Kernel RX timestamps, taken when the driver hands the frame to the stack, plus
+    // the controller's own timestamp where the driver provides one (trace/log only)
+    int ts_flags = SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE |
+                   SOF_TIMESTAMPING_RX_HARDWARE | SOF_TIMESTAMPING_RAW_HARDWARE;
+    if (setsockopt(can_socket_, SOL_SOCKET, SO_TIMESTAMPING, &ts_flags, sizeof(ts_flags)) < 0)
     {
-        std::cerr << "Warning: cannot enable CAN_RAW_RECV_OWN_MSGS\n";
+        std::cerr << "Warning: cannot enable SO_TIMESTAMPING\n";
     }
+    // Some drivers only stamp in hardware once asked to; most CAN drivers reject this
+    // (or need CAP_NET_ADMIN) and we stay on software timestamps
+    struct hwtstamp_config hw_cfg{};
+    hw_cfg.tx_type = HWTSTAMP_TX_OFF;
+    hw_cfg.rx_filter = HWTSTAMP_FILTER_ALL;
+    ifr.ifr_data = reinterpret_cast<char *>(&hw_cfg);
+    ioctl(can_socket_, SIOCSHWTSTAMP, &ifr);
 
+    interface_name_ = interface;
     std::cout << "Socket successfully bound to " << interface << std::endl;
     return true;
 }
 
-bool CANInterface::sendFrame(uint32_t frame_id, const std::vector<uint8_t> &data)
+bool CANInterface::attachSocket(int fd, const std::string &name)
 {
-    if (can_socket_ < 0)
+    stopTransmitThread();
+    stopReceiveThread();
+    closeSocket();
+    if (fd < 0)
+        return false;
+    const int flags = fcntl(fd, F_GETFL);
+    if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0)
     {
-        std::cerr << "Error: Socket is not open. Call openInterface() first." << std::endl;
+        std::cerr << "Error: could not make socket " << name << " non-blocking." << std::endl;
+        close(fd);
         return false;
     }
+    can_socket_ = fd;
+    interface_name_ = name;
+    return true;
+}
 
-    if (data.size() > 8)
+bool CANInterface::sendFrame(uint32_t frame_id, std::span<const uint8_t> data, TxPriority priority)
+{
+    if (data.size() > CAN_MAX_DLEN)
     {
         std::cerr << "Error: CAN frame data length exceeds 8 bytes." << std::endl;
         return false;
@@ -74,60 +125,609 @@ bool CANInterface::sendFrame(uint32_t frame_id, const std::vector<uint8_t> &data
 
     struct can_frame frame{};
     frame.can_id = frame_id & CAN_SFF_MASK;
-    frame.can_dlc = data.size();
-    std::memset(frame.data, 0, sizeof(frame.data));
+    frame.can_dlc = static_cast<uint8_t>(data.size());
     std::memcpy(frame.data, data.data(), data.size());
+    return sendFrames({&frame, 1}, priority);
+}
+
+bool CANInterface::sendFrames(std::span<const Frame> frames, TxPriority priority)
+{
+    if (can_socket_ < 0)
+    {
+        std::cerr << "Error: Socket is not open. Call openInterface() first." << std::endl;
+        return false;
+    }
+
+    bool ok = true;
+    {
+        std::lock_guard<std::mutex> lock(tx_mutex_);
+        if (!tx_running_)
+        {
+            int error = 0;
+            const size_t sent = writeFrames(frames, error);
+            if (sent == frames.size())
+                return true;
+            // No queue to keep the rest in: it is dropped (full) or failed
+            countUnsent(frames.size() - sent, error);
+            return false;
+        }
+
+        for (const Frame &f : frames)
+        {
+            if (priority == TxPriority::SETPOINT && !(f.can_id & CAN_EFF_FLAG))
+            {
+                const uint16_t id = static_cast<uint16_t>(f.can_id & CAN_SFF_MASK);
+                if (tx_pending_[id])
+                {
+                    tx_coalesced_.fetch_add(1, std::memory_order_relaxed);
+                }
+                else
+                {
+                    tx_pending_[id] = true;
+                    tx_order_[tx_order_count_++] = id;
+                }
+                tx_latest_[id] = f;
+            }
+            else if (tx_urgent_count_ < TX_URGENT_CAPACITY)
+            {
+                tx_urgent_[(tx_urgent_head_ + tx_urgent_count_++) % TX_URGENT_CAPACITY] = f;
+            }
+            else
+            {
+                tx_dropped_.fetch_add(1, std::memory_order_relaxed);
+                ok = false;
+            }
+        }
+    }
+    tx_cv_.notify_one();
+    if (!ok)
+        std::cerr << "Error: CAN TX queue full, urgent frame dropped." << std::endl;
+    return ok;
+}
+
+size_t CANInterface::writeFrames(std::span<const Frame> frames, int &error)
+{
+    struct mmsghdr msgs[MAX_BATCH];
+    struct iovec iovs[MAX_BATCH];
+
+    error = 0;
+    size_t sent = 0;
+    while (sent < frames.size())
+    {
+        const size_t count = std::min(frames.size() - sent, MAX_BATCH);
+        std::memset(msgs, 0, sizeof(msgs[0]) * count);
+        for (size_t i = 0; i < count; ++i)
+        {
+            iovs[i].iov_base = const_cast<Frame *>(&frames[sent + i]);
+            iovs[i].iov_len = sizeof(Frame);
+            msgs[i].msg_hdr.msg_iov = &iovs[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        int n = sendmmsg(can_socket_, msgs, count, 0);
+        if (n <= 0)
+        {
+            error = n < 0 ? errno : EAGAIN;
+            if (error == EINTR)
+                continue;
+            break;
+        }
+        const uint64_t now = CANTrace::monotonicNs();
+        for (int i = 0; i < n; ++i)
+        {
+            const Frame &f = frames[sent + i];
+            countTx(f);
+            if (f.can_id & CAN_EFF_FLAG)
+                continue;
+            CANNodeHandler *node = nodes_[(f.can_id >> 5) & (MAX_NODES - 1)].load(std::memory_order_acquire);
+            if (node)
+                node->onTransmit(static_cast<uint8_t>(f.can_id & 0x1F), f.data, f.can_dlc, now);
+        }
+        if (trace_.enabled())
+        {
+            for (int i = 0; i < n; ++i)
+                trace_.record(CANTrace::Direction::TX, frames[sent + i], now);
+        }
+        sent += static_cast<size_t>(n);
+    }
+    return sent;
+}
+
+void CANInterface::countUnsent(size_t count, int error)
+{
+    if (wouldBlock(error))
+    {
+        tx_dropped_.fetch_add(count, std::memory_order_relaxed);
+        std::cerr << "Warning: CAN TX queue of " << interface_name_ << " full, "
+                  << count << " frames dropped." << std::endl;
+    }
+    else
+    {
+        tx_errors_.fetch_add(count, std::memory_order_relaxed);
+        std::cerr << "Error: Failed to send " << count << " CAN frames on " << interface_name_
+                  << ": " << std::strerror(error) << std::endl;
+    }
+}
 
-    int nbytes = write(can_socket_, &frame, sizeof(frame));
-    if (nbytes != static_cast<int>(sizeof(frame)))
+bool CANInterface::setReceiveOwnMessages(bool enable)
+{
+    int recv_own = enable ? 1 : 0;
+    if (setsockopt(can_socket_, SOL_CAN_RAW,
+                   CAN_RAW_RECV_OWN_MSGS,
+                   &recv_own, sizeof(recv_own)) < 0)
     {
-        std::cerr << "Error: Failed to send CAN frame." << std::endl;
+        std::cerr << "Warning: cannot set CAN_RAW_RECV_OWN_MSGS\n";
         return false;
     }
+    return true;
+}
 
-    std::cout << "Sent CAN frame: ID=0x" << std::hex << frame_id << std::dec
-              << ", Data=";
-    for (size_t i = 0; i < data.size(); ++i)
+bool CANInterface::setFilters(std::span<const struct can_filter> filters)
+{
+    if (setsockopt(can_socket_, SOL_CAN_RAW, CAN_RAW_FILTER,
+                   filters.empty() ? nullptr : filters.data(),
+                   static_cast<socklen_t>(filters.size_bytes())) < 0)
     {
-        std::cout << std::hex << static_cast<int>(data[i]) << " ";
+        std::cerr << "Error: cannot install " << filters.size() << " CAN_RAW_FILTERs." << std::endl;
+        return false;
     }
-    std::cout << std::dec << std::endl;
     return true;
 }
 
+bool CANInterface::applyNodeFilters(std::span<const uint8_t> cmd_ids)
+{
+    std::vector<struct can_filter> filters;
+    for (size_t node = 0; node < MAX_NODES; ++node)
+    {
+        if (!nodes_[node].load(std::memory_order_acquire))
+            continue;
+        for (uint8_t cmd : cmd_ids)
+        {
+            struct can_filter f;
+            f.can_id = static_cast<canid_t>((node << 5) | (cmd & 0x1F));
+            f.can_mask = CAN_SFF_MASK | CAN_EFF_FLAG | CAN_RTR_FLAG;
+            filters.push_back(f);
+        }
+    }
+    if (filters.empty())
+    {
+        std::cerr << "Warning: no CAN nodes registered, leaving RX filters unchanged." << std::endl;
+        return false;
+    }
+    return setFilters(filters);
+}
+
 void CANInterface::registerFeedbackCallback(FeedbackCallback cb)
 {
     callback_ = cb;
 }
 
-void CANInterface::receiveLoop()
+bool CANInterface::registerNode(uint8_t node_id, CANNodeHandler *handler)
+{
+    if (node_id >= MAX_NODES)
+    {
+        std::cerr << "Error: CAN node id " << static_cast<int>(node_id) << " out of range." << std::endl;
+        return false;
+    }
+    nodes_[node_id].store(handler, std::memory_order_release);
+    return true;
+}
+
+bool CANInterface::startTransmitThread()
 {
     if (can_socket_ < 0)
     {
         std::cerr << "Error: Socket is not open. Call openInterface() first." << std::endl;
-        return;
+        return false;
     }
+    if (tx_thread_.joinable())
+        return true;
 
-    struct can_frame frame;
+    {
+        std::lock_guard<std::mutex> lock(tx_mutex_);
+        tx_stop_ = false;
+        tx_running_ = true;
+    }
+    tx_thread_ = std::thread(&CANInterface::transmitLoop, this);
+    std::string error;
+    if (!applyRtConfig(tx_thread_.native_handle(), tx_config_, error))
+        std::cerr << "Warning: CAN TX thread on " << interface_name_ << ": " << error << std::endl;
+    return true;
+}
+
+void CANInterface::stopTransmitThread()
+{
+    {
+        std::lock_guard<std::mutex> lock(tx_mutex_);
+        // Later sends go straight to the socket; the thread flushes the queue first
+        tx_running_ = false;
+        tx_stop_ = true;
+    }
+    tx_cv_.notify_one();
+    if (tx_thread_.joinable())
+        tx_thread_.join();
+}
+
+void CANInterface::setTransmitThreadConfig(const RtThreadConfig &config)
+{
+    tx_config_ = config;
+}
+
+std::string CANInterface::describeTransmitThread()
+{
+    return tx_thread_.joinable() ? describeThread(tx_thread_.native_handle()) : std::string();
+}
+
+void CANInterface::transmitLoop()
+{
+    if (tx_config_.prefault_stack)
+        prefaultStack();
+
+    Frame batch[MAX_BATCH];
+    int blocked_while_stopping = 0;
+    std::unique_lock<std::mutex> lock(tx_mutex_);
     while (true)
     {
-        int nbytes = read(can_socket_, &frame, sizeof(frame));
-        if (nbytes < 0)
+        tx_cv_.wait(lock, [this]()
+                    { return tx_stop_ || tx_urgent_count_ > 0 || tx_order_count_ > 0; });
+        if (tx_urgent_count_ == 0 && tx_order_count_ == 0)
+            break; // stopping and fully flushed
+
+        // Urgent frames first, then the newest setpoint per ID, oldest ID first
+        size_t n = 0;
+        while (n < MAX_BATCH && tx_urgent_count_ > 0)
         {
-            std::cerr << "Error: Failed to read from CAN socket." << std::endl;
+            batch[n++] = tx_urgent_[tx_urgent_head_];
+            tx_urgent_head_ = (tx_urgent_head_ + 1) % TX_URGENT_CAPACITY;
+            --tx_urgent_count_;
+        }
+        const size_t urgent = n;
+        size_t taken = 0;
+        while (n < MAX_BATCH && taken < tx_order_count_)
+        {
+            const uint16_t id = tx_order_[taken++];
+            tx_pending_[id] = false;
+            batch[n++] = tx_latest_[id];
+        }
+        if (taken > 0)
+        {
+            std::copy(tx_order_.begin() + taken, tx_order_.begin() + tx_order_count_, tx_order_.begin());
+            tx_order_count_ -= taken;
+        }
+
+        // Producers keep queueing (and coalescing) while we are in the syscall
+        lock.unlock();
+        int error = 0;
+        const size_t sent = writeFrames({batch, n}, error);
+        lock.lock();
+        if (sent == n)
+            continue;
+        if (!wouldBlock(error))
+        {
+            countUnsent(n - sent, error);
+            continue;
+        }
+
+        // Driver queue full: keep the unsent tail and retry once the socket drains
+        tx_blocked_.fetch_add(1, std::memory_order_relaxed);
+        requeueUnsent({batch, n}, urgent, sent);
+        if (tx_stop_ && ++blocked_while_stopping > TX_STOP_RETRIES)
+        {
+            // Bus is not draining; give up on the rest so stopTransmitThread() can join
+            const size_t left = tx_urgent_count_ + tx_order_count_;
+            for (size_t i = 0; i < tx_order_count_; ++i)
+                tx_pending_[tx_order_[i]] = false;
+            tx_urgent_count_ = 0;
+            tx_order_count_ = 0;
+            countUnsent(left, error);
             break;
         }
-        else if (nbytes < static_cast<int>(sizeof(frame)))
+        lock.unlock();
+        waitWritable(error);
+        lock.lock();
+    }
+}
+
+void CANInterface::requeueUnsent(std::span<const Frame> batch, size_t urgent, size_t sent)
+{
+    // Urgent frames go back in front of the FIFO in their original order
+    for (size_t i = urgent; i-- > sent;)
+    {
+        if (tx_urgent_count_ == TX_URGENT_CAPACITY)
         {
-            std::cerr << "Error: Incomplete CAN frame received." << std::endl;
+            tx_dropped_.fetch_add(1, std::memory_order_relaxed);
             continue;
         }
+        tx_urgent_head_ = (tx_urgent_head_ + TX_URGENT_CAPACITY - 1) % TX_URGENT_CAPACITY;
+        tx_urgent_[tx_urgent_head_] = batch[i];
+        ++tx_urgent_count_;
+    }
 
-        if (callback_)
+    // A setpoint superseded while we were in the syscall is coalesced; the others
+    // take their old place at the front of the order
+    uint16_t ids[MAX_BATCH];
+    size_t count = 0;
+    for (size_t i = std::max(urgent, sent); i < batch.size(); ++i)
+    {
+        const uint16_t id = batch[i].can_id & CAN_SFF_MASK;
+        if (tx_pending_[id])
         {
-            uint8_t data[8];
-            std::memcpy(data, frame.data, frame.can_dlc);
-            callback_(frame.can_id, data);
+            tx_coalesced_.fetch_add(1, std::memory_order_relaxed);
+            continue;
         }
+        tx_pending_[id] = true;
+        tx_latest_[id] = batch[i];
+        ids[count++] = id;
+    }
+    if (count > 0)
+    {
+        std::copy_backward(tx_order_.begin(), tx_order_.begin() + tx_order_count_,
+                           tx_order_.begin() + tx_order_count_ + count);
+        std::copy(ids, ids + count, tx_order_.begin());
+        tx_order_count_ += count;
     }
 }
+
+void CANInterface::waitWritable(int error)
+{
+    // EAGAIN: POLLOUT fires once the socket send buffer drains. ENOBUFS comes from
+    // the device queue, which POLLOUT does not track, so just back off.
+    if (error == ENOBUFS)
+    {
+        poll(nullptr, 0, TX_BLOCKED_WAIT_MS);
+        return;
+    }
+    struct pollfd pfd{};
+    pfd.fd = can_socket_;
+    pfd.events = POLLOUT;
+    poll(&pfd, 1, TX_BLOCKED_WAIT_MS);
+}
+
+bool CANInterface::startReceiveThread()
+{
+    if (can_socket_ < 0)
+    {
+        std::cerr << "Error: Socket is not open. Call openInterface() first." << std::endl;
+        return false;
+    }
+    if (rx_thread_.joinable())
+        return true;
+
+    stop_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    if (stop_fd_ < 0 || epoll_fd_ < 0)
+    {
+        std::cerr << "Error: could not create epoll/eventfd for CAN RX." << std::endl;
+        stopReceiveThread();
+        return false;
+    }
+
+    struct epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.fd = can_socket_;
+    bool ok = epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, can_socket_, &ev) == 0;
+    ev.data.fd = stop_fd_;
+    ok = ok && epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, stop_fd_, &ev) == 0;
+    if (!ok)
+    {
+        std::cerr << "Error: epoll_ctl failed for CAN RX." << std::endl;
+        stopReceiveThread();
+        return false;
+    }
+
+    rx_thread_ = std::thread(&CANInterface::receiveLoop, this);
+    std::string error;
+    if (!applyRtConfig(rx_thread_.native_handle(), rx_config_, error))
+        std::cerr << "Warning: CAN RX thread on " << interface_name_ << ": " << error << std::endl;
+    return true;
+}
+
+void CANInterface::setReceiveThreadConfig(const RtThreadConfig &config)
+{
+    rx_config_ = config;
+}
+
+std::string CANInterface::describeReceiveThread()
+{
+    return rx_thread_.joinable() ? describeThread(rx_thread_.native_handle()) : std::string();
+}
+
+void CANInterface::stopReceiveThread()
+{
+    if (rx_thread_.joinable())
+    {
+        uint64_t one = 1;
+        if (write(stop_fd_, &one, sizeof(one)) != sizeof(one))
+            std::cerr << "Warning: could not signal CAN RX thread." << std::endl;
+        rx_thread_.join();
+    }
+    if (epoll_fd_ >= 0)
+    {
+        close(epoll_fd_);
+        epoll_fd_ = -1;
+    }
+    if (stop_fd_ >= 0)
+    {
+        close(stop_fd_);
+        stop_fd_ = -1;
+    }
+}
+
+namespace
+{
+// Offset to map CLOCK_REALTIME kernel timestamps onto CLOCK_MONOTONIC
+int64_t realtimeToMonotonicOffsetNs()
+{
+    struct timespec rt, mono;
+    clock_gettime(CLOCK_REALTIME, &rt);
+    clock_gettime(CLOCK_MONOTONIC, &mono);
+    return (static_cast<int64_t>(mono.tv_sec) - rt.tv_sec) * 1000000000ll +
+           (static_cast<int64_t>(mono.tv_nsec) - rt.tv_nsec);
+}
+
+struct RxTimestamps
+{
+    uint64_t software_ns; // kernel receive time, CLOCK_MONOTONIC
+    uint64_t hardware_ns; // controller timestamp mapped the same way, 0 = none
+};
+
+RxTimestamps extractTimestamps(const struct msghdr &hdr, int64_t rt_to_mono)
+{
+    RxTimestamps out{0, 0};
+    for (struct cmsghdr *c = CMSG_FIRSTHDR(&hdr); c; c = CMSG_NXTHDR(const_cast<struct msghdr *>(&hdr), c))
+    {
+        if (c->cmsg_level != SOL_SOCKET || c->cmsg_type != SO_TIMESTAMPING)
+            continue;
+        struct scm_timestamping ts;
+        std::memcpy(&ts, CMSG_DATA(c), sizeof(ts));
+        // ts[0]: software (CLOCK_REALTIME). ts[2]: raw hardware; CAN drivers start
+        // their timecounter from CLOCK_REALTIME, so it maps with the same offset
+        auto toMono = [rt_to_mono](const struct timespec &t) -> uint64_t
+        {
+            if (t.tv_sec == 0 && t.tv_nsec == 0)
+                return 0;
+            return static_cast<uint64_t>(static_cast<int64_t>(t.tv_sec) * 1000000000ll + t.tv_nsec + rt_to_mono);
+        };
+        out.software_ns = toMono(ts.ts[0]);
+        out.hardware_ns = toMono(ts.ts[2]);
+        break;
+    }
+    if (out.software_ns == 0)
+        out.software_ns = CANTrace::monotonicNs();
+    return out;
+}
+} // namespace
+
+void CANInterface::receiveLoop()
+{
+    if (rx_config_.prefault_stack)
+        prefaultStack();
+
+    struct can_frame frames[RX_BATCH];
+    struct iovec iovs[RX_BATCH];
+    struct mmsghdr msgs[RX_BATCH];
+    alignas(struct cmsghdr) char ctrl[RX_BATCH][CMSG_SPACE(sizeof(struct scm_timestamping))];
+
+    struct epoll_event events[2];
+    while (true)
+    {
+        int nev = epoll_wait(epoll_fd_, events, 2, -1);
+        if (nev < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            std::cerr << "Error: epoll_wait failed on CAN RX." << std::endl;
+            return;
+        }
+
+        bool readable = false;
+        for (int e = 0; e < nev; ++e)
+        {
+            if (events[e].data.fd == stop_fd_)
+                return;
+            readable = true;
+        }
+        if (!readable)
+            continue;
+
+        // Drain everything queued in the socket, RX_BATCH frames per syscall
+        while (true)
+        {
+            for (size_t i = 0; i < RX_BATCH; ++i)
+            {
+                iovs[i].iov_base = &frames[i];
+                iovs[i].iov_len = sizeof(frames[i]);
+                std::memset(&msgs[i], 0, sizeof(msgs[i]));
+                msgs[i].msg_hdr.msg_iov = &iovs[i];
+                msgs[i].msg_hdr.msg_iovlen = 1;
+                msgs[i].msg_hdr.msg_control = ctrl[i];
+                msgs[i].msg_hdr.msg_controllen = sizeof(ctrl[i]);
+            }
+
+            int n = recvmmsg(can_socket_, msgs, RX_BATCH, MSG_DONTWAIT, nullptr);
+            if (n < 0)
+            {
+                if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                    std::cerr << "Error: Failed to read from CAN socket." << std::endl;
+                break;
+            }
+
+            const int64_t rt_to_mono = realtimeToMonotonicOffsetNs();
+            for (int i = 0; i < n; ++i)
+            {
+                if (msgs[i].msg_len < sizeof(struct can_frame))
+                {
+                    std::cerr << "Error: Incomplete CAN frame received." << std::endl;
+                    continue;
+                }
+                const struct can_frame &frame = frames[i];
+                // Handlers compare against CLOCK_MONOTONIC "now", so they get the kernel
+                // stamp; the hardware one may drift from it and only goes to the trace
+                const RxTimestamps stamps = extractTimestamps(msgs[i].msg_hdr, rt_to_mono);
+                const uint64_t ts = stamps.software_ns;
+
+                if (frame.can_id & CAN_ERR_FLAG)
+                {
+                    bus_errors_.fetch_add(1, std::memory_order_relaxed);
+                    continue;
+                }
+                rx_frames_.fetch_add(1, std::memory_order_relaxed);
+                rx_bytes_.fetch_add(frame.can_dlc, std::memory_order_relaxed);
+                rx_bits_.fetch_add(frameBits(frame.can_dlc), std::memory_order_relaxed);
+
+                if (stamps.hardware_ns)
+                    trace_.record(CANTrace::Direction::RX, frame, stamps.hardware_ns, true);
+                else
+                    trace_.record(CANTrace::Direction::RX, frame, ts);
+
+                // ODrive only sends standard data frames; an extended or remote frame
+                // would alias onto a node ID through the mask below
+                if (frame.can_id & (CAN_EFF_FLAG | CAN_RTR_FLAG))
+                    continue;
+                const uint32_t can_id = frame.can_id & CAN_SFF_MASK;
+                CANNodeHandler *node = nodes_[(can_id >> 5) & (MAX_NODES - 1)].load(std::memory_order_acquire);
+                if (node)
+                    node->onFrame(static_cast<uint8_t>(can_id & 0x1F), frame.data, frame.can_dlc, ts);
+                else if (callback_)
+                    callback_(frame.can_id, frame.data, frame.can_dlc, ts);
+            }
+
+            if (n < static_cast<int>(RX_BATCH))
+                break;
+        }
+    }
+}
+
+bool CANInterface::startTrace(const std::string &path, CANTrace::Format format)
+{
+    return trace_.start(path, interface_name_.empty() ? "can" : interface_name_, format);
+}
+
+void CANInterface::setTraceLevel(CANTrace::Level level)
+{
+    trace_.setLevel(level);
+}
+
+void CANInterface::countTx(const struct can_frame &frame)
+{
+    tx_frames_.fetch_add(1, std::memory_order_relaxed);
+    tx_bytes_.fetch_add(frame.can_dlc, std::memory_order_relaxed);
+    tx_bits_.fetch_add(frameBits(frame.can_dlc), std::memory_order_relaxed);
+}
+
+CANStats CANInterface::getStats() const
+{
+    CANStats s;
+    s.tx_frames = tx_frames_.load(std::memory_order_relaxed);
+    s.rx_frames = rx_frames_.load(std::memory_order_relaxed);
+    s.tx_bytes = tx_bytes_.load(std::memory_order_relaxed);
+    s.rx_bytes = rx_bytes_.load(std::memory_order_relaxed);
+    s.tx_bits = tx_bits_.load(std::memory_order_relaxed);
+    s.rx_bits = rx_bits_.load(std::memory_order_relaxed);
+    s.tx_errors = tx_errors_.load(std::memory_order_relaxed);
+    s.bus_errors = bus_errors_.load(std::memory_order_relaxed);
+    s.tx_coalesced = tx_coalesced_.load(std::memory_order_relaxed);
+    s.tx_dropped = tx_dropped_.load(std::memory_order_relaxed);
+    s.tx_blocked = tx_blocked_.load(std::memory_order_relaxed);
+    return s;
+}
@@ -0,0 +1,73 @@
+#include "odrive_interface/can_log.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+CANLogReader::~CANLogReader()
+{
+    close();
+}
+
+bool CANLogReader::open(const std::string &path, std::string &error)
+{
+    close();
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        error = path + ": " + std::strerror(errno);
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(CANLogHeader))
+    {
+        error = path + ": not a CAN log (too short)";
+        ::close(fd);
+        return false;
+    }
+    map_size_ = static_cast<size_t>(st.st_size);
+    map_ = mmap(nullptr, map_size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (map_ == MAP_FAILED)
+    {
+        map_ = nullptr;
+        error = path + ": mmap failed: " + std::strerror(errno);
+        return false;
+    }
+
+    header_ = static_cast<const CANLogHeader *>(map_);
+    if (std::memcmp(header_->magic, CANLogHeader::MAGIC, sizeof(header_->magic)) != 0 ||
+        header_->version != CANLogHeader::VERSION || header_->record_size != sizeof(CANLogRecord))
+    {
+        error = path + ": unsupported CAN log format";
+        close();
+        return false;
+    }
+    records_ = reinterpret_cast<const CANLogRecord *>(static_cast<const char *>(map_) + sizeof(CANLogHeader));
+    count_ = (map_size_ - sizeof(CANLogHeader)) / sizeof(CANLogRecord);
+    // Replay walks the file front to back
+    madvise(map_, map_size_, MADV_SEQUENTIAL);
+    return true;
+}
+
+void CANLogReader::close()
+{
+    if (map_)
+        munmap(map_, map_size_);
+    map_ = nullptr;
+    map_size_ = 0;
+    header_ = nullptr;
+    records_ = nullptr;
+    count_ = 0;
+}
+
+size_t CANLogReader::lowerBound(uint64_t timestamp_ns) const
+{
+    const CANLogRecord *it = std::lower_bound(begin(), end(), timestamp_ns,
+                                              [](const CANLogRecord &r, uint64_t t)
+                                              { return r.timestamp_ns < t; });
+    return static_cast<size_t>(it - begin());
+}
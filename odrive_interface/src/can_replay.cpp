@@ -0,0 +1,174 @@
+// Phát lại log CAN nhị phân (can_trace_format:=binary) lên một bus, giữ đúng khoảng cách thời gian.
+//   ros2 run odrive_interface odrive_can_replay --ros-args -p log_file:=/tmp/odrive_can0_20260101-120000.canlog
+//     -p can_interface:=vcan0 -p direction:=rx -p speed:=1.0
+// direction: rx  = frame ODrive đã gửi (feedback/heartbeat), chạy odrive_interface_node trên vcan0 để tái hiện trận đấu
+//            tx  = lệnh node đã gửi, dùng để lái odrive_sim_node hoặc ODrive thật
+//            all = cả hai
+// speed: 1.0 = thời gian thực, 2.0 = nhanh gấp đôi, 0 = nhanh nhất có thể
+// start_s / end_s: cắt đoạn theo giây tính từ frame đầu tiên (end_s <= 0: đến hết file)
+#include <rclcpp/rclcpp.hpp>
+#include "odrive_interface/can_comm.hpp"
+#include "odrive_interface/can_log.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <ctime>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+using namespace std;
+
+class CanReplayNode : public rclcpp::Node
+{
+public:
+  CanReplayNode() : Node("odrive_can_replay")
+  {
+    auto log_file = declare_parameter<string>("log_file", "");
+    auto iface = declare_parameter<string>("can_interface", "vcan0");
+    speed_ = declare_parameter<double>("speed", 1.0);
+    auto direction = declare_parameter<string>("direction", "rx");
+    auto start_s = declare_parameter<double>("start_s", 0.0);
+    auto end_s = declare_parameter<double>("end_s", 0.0);
+    loop_ = declare_parameter<bool>("loop", false);
+
+    if (direction == "rx")
+      want_tx_ = false, want_rx_ = true;
+    else if (direction == "tx")
+      want_tx_ = true, want_rx_ = false;
+    else if (direction == "all")
+      want_tx_ = want_rx_ = true;
+    else
+      throw runtime_error("direction must be rx, tx or all, got " + direction);
+    if (speed_ < 0.0)
+      throw runtime_error("speed must be >= 0");
+
+    string error;
+    if (!log_.open(log_file, error))
+      throw runtime_error(error);
+    if (log_.size() == 0)
+      throw runtime_error(log_file + ": no frames recorded");
+
+    // Cắt đoạn bằng tìm kiếm nhị phân trên timestamp (file đã sắp theo thời gian)
+    const uint64_t t0 = log_[0].timestamp_ns;
+    first_ = log_.lowerBound(t0 + static_cast<uint64_t>(max(0.0, start_s) * 1e9));
+    last_ = end_s > 0.0 ? log_.lowerBound(t0 + static_cast<uint64_t>(end_s * 1e9)) : log_.size();
+    if (first_ >= last_)
+      throw runtime_error("start_s/end_s select no frames");
+
+    if (!can_.openInterface(iface))
+      throw runtime_error("Could not open " + iface);
+
+    RCLCPP_INFO(get_logger(), "Replaying %zu/%zu records of %s (recorded on %s) to %s, %s, speed %.2f%s",
+                last_ - first_, log_.size(), log_file.c_str(), log_.header().interface, iface.c_str(),
+                direction.c_str(), speed_, loop_ ? ", looping" : "");
+    player_ = thread(&CanReplayNode::play, this);
+  }
+
+  ~CanReplayNode() override
+  {
+    running_ = false;
+    if (player_.joinable())
+      player_.join();
+  }
+
+private:
+  static uint64_t now_ns()
+  {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + static_cast<uint64_t>(ts.tv_nsec);
+  }
+
+  // Ngủ tới thời điểm tuyệt đối, tối đa 100 ms mỗi lần để dừng kịp khi shutdown
+  bool sleep_until(uint64_t deadline_ns)
+  {
+    while (running_)
+    {
+      const uint64_t now = now_ns();
+      if (now >= deadline_ns)
+        return true;
+      const uint64_t wake = min<uint64_t>(deadline_ns, now + 100000000ull);
+      struct timespec ts{static_cast<time_t>(wake / 1000000000ull), static_cast<long>(wake % 1000000000ull)};
+      clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr);
+    }
+    return false;
+  }
+
+  void play()
+  {
+    vector<CANInterface::Frame> batch;
+    batch.reserve(CANInterface::MAX_BATCH);
+    do
+    {
+      const uint64_t log_start = log_[first_].timestamp_ns;
+      const uint64_t wall_start = now_ns();
+      uint64_t sent = 0;
+      uint64_t late_max_ns = 0;
+      double late_sum_ns = 0.0;
+
+      size_t i = first_;
+      while (i < last_ && running_)
+      {
+        // Thời điểm phát của record i theo tốc độ phát lại
+        const uint64_t offset = log_[i].timestamp_ns - log_start;
+        const uint64_t due = wall_start + (speed_ > 0.0 ? static_cast<uint64_t>(static_cast<double>(offset) / speed_) : 0);
+        if (!sleep_until(due))
+          break;
+
+        // Gom mọi frame đã đến hạn vào một lần sendmmsg()
+        const uint64_t now = now_ns();
+        batch.clear();
+        for (; i < last_ && batch.size() < CANInterface::MAX_BATCH; ++i)
+        {
+          const CANLogRecord &r = log_[i];
+          const uint64_t r_due = wall_start + (speed_ > 0.0 ? static_cast<uint64_t>(static_cast<double>(r.timestamp_ns - log_start) / speed_) : 0);
+          if (r_due > now)
+            break;
+          if (r.isTx() ? !want_tx_ : !want_rx_)
+            continue;
+          CANInterface::Frame f{};
+          f.can_id = r.can_id;
+          f.can_dlc = min<uint8_t>(r.dlc, 8);
+          copy(r.data, r.data + f.can_dlc, f.data);
+          batch.push_back(f);
+          late_max_ns = max(late_max_ns, now - r_due);
+          late_sum_ns += static_cast<double>(now - r_due);
+        }
+        if (!batch.empty() && can_.sendFrames(batch))
+          sent += batch.size();
+      }
+
+      if (sent > 0)
+        RCLCPP_INFO(get_logger(), "Sent %lu frames in %.3f s, lateness mean %.1f us max %.1f us",
+                    sent, static_cast<double>(now_ns() - wall_start) / 1e9,
+                    late_sum_ns / static_cast<double>(sent) / 1000.0, static_cast<double>(late_max_ns) / 1000.0);
+      else
+      {
+        RCLCPP_WARN(get_logger(), "No frames matched the selected direction");
+        break;
+      }
+    } while (loop_ && running_);
+
+    if (running_)
+      rclcpp::shutdown();
+  }
+
+  CANInterface can_;
+  CANLogReader log_;
+  double speed_;
+  bool loop_;
+  bool want_tx_{false};
+  bool want_rx_{true};
+  size_t first_{0};
+  size_t last_{0};
+  atomic<bool> running_{true};
+  thread player_;
+};
+
+int main(int argc, char **argv)
+{
+  rclcpp::init(argc, argv);
+  rclcpp::spin(std::make_shared<CanReplayNode>());
+  rclcpp::shutdown();
+  return 0;
+}
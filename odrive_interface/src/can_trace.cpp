@@ -0,0 +1,224 @@
+#include "odrive_interface/can_trace.hpp"
+#include "odrive_interface/can_log.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+
+CANTrace::CANTrace()
+{
+    for (size_t i = 0; i < CAPACITY; ++i)
+        slots_[i].seq.store(i, std::memory_order_relaxed);
+}
+
+CANTrace::~CANTrace()
+{
+    stop();
+}
+
+uint64_t CANTrace::monotonicNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+bool CANTrace::start(const std::string &path, const std::string &interface, Format format)
+{
+    stop();
+    interface_ = interface;
+    format_ = format;
+    pending_.clear();
+    last_written_ns_ = 0;
+    // Entries carry monotonic time; one offset keeps the log's wall-clock time
+    // steady even if NTP steps the clock while recording
+    struct timespec rt;
+    clock_gettime(CLOCK_REALTIME, &rt);
+    const uint64_t mono = monotonicNs();
+    realtime_offset_ns_ = static_cast<int64_t>(static_cast<uint64_t>(rt.tv_sec) * 1000000000ull +
+                                               static_cast<uint64_t>(rt.tv_nsec) - mono);
+    if (!path.empty())
+    {
+        file_ = std::fopen(path.c_str(), format == Format::BINARY ? "wb" : "w");
+        if (!file_)
+        {
+            std::cerr << "Error: could not open CAN trace file " << path << std::endl;
+            return false;
+        }
+        if (format == Format::BINARY && !writeBinaryHeader())
+        {
+            std::cerr << "Error: could not write CAN log header to " << path << std::endl;
+            std::fclose(file_);
+            file_ = nullptr;
+            return false;
+        }
+    }
+    running_ = true;
+    dumper_ = std::thread(&CANTrace::dumpLoop, this);
+    return true;
+}
+
+void CANTrace::stop()
+{
+    running_ = false;
+    if (dumper_.joinable())
+        dumper_.join();
+    if (file_)
+    {
+        std::fclose(file_);
+        file_ = nullptr;
+    }
+}
+
+void CANTrace::record(Direction dir, const struct can_frame &frame)
+{
+    record(dir, frame, monotonicNs());
+}
+
+void CANTrace::record(Direction dir, const struct can_frame &frame, uint64_t timestamp_ns,
+                      bool hw_timestamp)
+{
+    if (!enabled())
+        return;
+
+    // Bounded MPSC ring: each slot's sequence number tells producers whether it is free
+    uint64_t pos = head_.load(std::memory_order_relaxed);
+    Slot *slot;
+    while (true)
+    {
+        slot = &slots_[pos & MASK];
+        const uint64_t seq = slot->seq.load(std::memory_order_acquire);
+        const int64_t diff = static_cast<int64_t>(seq) - static_cast<int64_t>(pos);
+        if (diff == 0)
+        {
+            if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                break;
+        }
+        else if (diff < 0)
+        {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        else
+        {
+            pos = head_.load(std::memory_order_relaxed);
+        }
+    }
+
+    slot->entry.timestamp_ns = timestamp_ns;
+    slot->entry.frame = frame;
+    slot->entry.dir = dir;
+    slot->entry.hw_timestamp = hw_timestamp;
+    slot->seq.store(pos + 1, std::memory_order_release);
+}
+
+bool CANTrace::pop(Entry &out)
+{
+    Slot &slot = slots_[tail_ & MASK];
+    if (slot.seq.load(std::memory_order_acquire) != tail_ + 1)
+        return false;
+    out = slot.entry;
+    slot.seq.store(tail_ + CAPACITY, std::memory_order_release);
+    ++tail_;
+    return true;
+}
+
+void CANTrace::writeEntry(const Entry &e)
+{
+    const bool to_file = file_ && format_ == Format::CANDUMP;
+    if (!to_file && getLevel() != Level::CONSOLE)
+        return;
+
+    // candump -l format: (sec.usec) iface ID#DATA with realtime seconds, so
+    // canplayer/cantools read it as is; the direction is only kept in BINARY
+    const uint64_t ts = e.timestamp_ns + static_cast<uint64_t>(realtime_offset_ns_);
+    char line[96];
+    int n = std::snprintf(line, sizeof(line), "(%010llu.%06llu) %s %03X#",
+                          static_cast<unsigned long long>(ts / 1000000000ull),
+                          static_cast<unsigned long long>((ts / 1000ull) % 1000000ull),
+                          interface_.c_str(), e.frame.can_id & CAN_SFF_MASK);
+    for (uint8_t i = 0; i < e.frame.can_dlc && i < CAN_MAX_DLEN && n > 0; ++i)
+        n += std::snprintf(line + n, sizeof(line) - n, "%02X", e.frame.data[i]);
+    if (n > 0)
+        std::snprintf(line + n, sizeof(line) - n, "\n");
+
+    if (to_file)
+        std::fputs(line, file_);
+    if (getLevel() == Level::CONSOLE)
+        std::fputs(line, stdout);
+}
+
+bool CANTrace::writeBinaryHeader()
+{
+    CANLogHeader h{};
+    std::copy(std::begin(CANLogHeader::MAGIC), std::end(CANLogHeader::MAGIC), h.magic);
+    h.version = CANLogHeader::VERSION;
+    h.record_size = sizeof(CANLogRecord);
+    h.start_monotonic_ns = monotonicNs();
+    h.start_realtime_ns = h.start_monotonic_ns + static_cast<uint64_t>(realtime_offset_ns_);
+    std::strncpy(h.interface, interface_.c_str(), sizeof(h.interface) - 1);
+    return std::fwrite(&h, sizeof(h), 1, file_) == 1;
+}
+
+void CANTrace::writeBinary(bool flush_all)
+{
+    std::stable_sort(pending_.begin(), pending_.end(), [](const Entry &a, const Entry &b)
+                     { return a.timestamp_ns < b.timestamp_ns; });
+    const uint64_t horizon = flush_all ? UINT64_MAX : monotonicNs() - REORDER_WINDOW_NS;
+
+    size_t n = 0;
+    for (; n < pending_.size() && pending_[n].timestamp_ns <= horizon; ++n)
+    {
+        const Entry &e = pending_[n];
+        CANLogRecord r{};
+        r.timestamp_ns = e.timestamp_ns;
+        r.can_id = e.frame.can_id;
+        r.dlc = std::min<uint8_t>(e.frame.can_dlc, CAN_MAX_DLEN);
+        r.flags = e.dir == Direction::TX ? CANLogRecord::FLAG_TX : 0;
+        if (e.hw_timestamp)
+            r.flags |= CANLogRecord::FLAG_HW_TIMESTAMP;
+        std::memcpy(r.data, e.frame.data, r.dlc);
+        // A straggler older than what is already on disk keeps the file sorted
+        if (r.timestamp_ns < last_written_ns_)
+        {
+            r.timestamp_ns = last_written_ns_;
+            r.flags |= CANLogRecord::FLAG_REORDERED;
+        }
+        last_written_ns_ = r.timestamp_ns;
+        std::fwrite(&r, sizeof(r), 1, file_);
+    }
+    pending_.erase(pending_.begin(), pending_.begin() + static_cast<std::ptrdiff_t>(n));
+}
+
+void CANTrace::dumpLoop()
+{
+    uint64_t reported_drops = 0;
+    Entry e;
+    while (true)
+    {
+        const bool keep_running = running_.load();
+        while (pop(e))
+        {
+            if (format_ == Format::BINARY && file_)
+                pending_.push_back(e);
+            writeEntry(e);
+        }
+        if (format_ == Format::BINARY && file_)
+            writeBinary(!keep_running);
+        if (file_)
+            std::fflush(file_);
+
+        const uint64_t drops = droppedCount();
+        if (drops != reported_drops)
+        {
+            std::cerr << "Warning: CAN trace ring full, " << (drops - reported_drops)
+                      << " frames dropped" << std::endl;
+            reported_drops = drops;
+        }
+
+        if (!keep_running)
+            break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+}
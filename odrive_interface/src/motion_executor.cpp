@@ -0,0 +1,447 @@
+#include "odrive_interface/motion_executor.hpp"
+#include <algorithm>
+#include <iostream>
+
+// ────────────────────────────────────────────────────────────────
+// TimerWheel
+// ────────────────────────────────────────────────────────────────
+TimerWheel::TimerWheel(Clock::duration tick, size_t slots)
+    : tick_(tick), slots_(slots), origin_(Clock::now()) {}
+
+size_t TimerWheel::slotOf(Clock::time_point t) const
+{
+    // Deadlines already behind the wheel go into the current bucket
+    const int64_t tick = std::max<int64_t>((t - origin_) / tick_, last_tick_);
+    return static_cast<size_t>(tick % static_cast<int64_t>(slots_.size()));
+}
+
+void TimerWheel::add(uint64_t id, Clock::time_point deadline, Callback cb)
+{
+    const size_t slot = slotOf(deadline);
+    slots_[slot].push_back({id, deadline, std::move(cb)});
+    index_.emplace(id, slot);
+}
+
+bool TimerWheel::cancel(uint64_t id)
+{
+    auto it = index_.find(id);
+    if (it == index_.end())
+        return false;
+    auto &bucket = slots_[it->second];
+    bucket.erase(std::find_if(bucket.begin(), bucket.end(),
+                              [id](const Entry &e)
+                              { return e.id == id; }));
+    index_.erase(it);
+    return true;
+}
+
+void TimerWheel::expire(Clock::time_point now, std::vector<Callback> &out)
+{
+    if (index_.empty())
+    {
+        last_tick_ = std::max<int64_t>((now - origin_) / tick_, last_tick_);
+        return;
+    }
+
+    const int64_t now_tick = (now - origin_) / tick_;
+    const int64_t span = std::min<int64_t>(now_tick - last_tick_, static_cast<int64_t>(slots_.size()) - 1);
+
+    std::vector<Entry> due;
+    for (int64_t t = last_tick_; t <= last_tick_ + span; ++t)
+    {
+        auto &bucket = slots_[static_cast<size_t>(t % static_cast<int64_t>(slots_.size()))];
+        for (auto it = bucket.begin(); it != bucket.end();)
+        {
+            if (it->deadline <= now)
+            {
+                index_.erase(it->id);
+                due.push_back(std::move(*it));
+                it = bucket.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+    }
+    last_tick_ = std::max(now_tick, last_tick_);
+
+    std::sort(due.begin(), due.end(), [](const Entry &a, const Entry &b)
+              { return a.deadline < b.deadline || (a.deadline == b.deadline && a.id < b.id); });
+    for (auto &e : due)
+        out.push_back(std::move(e.cb));
+}
+
+std::optional<TimerWheel::Clock::time_point> TimerWheel::nextDeadline() const
+{
+    std::optional<Clock::time_point> next;
+    if (index_.empty())
+        return next;
+    for (const auto &bucket : slots_)
+        for (const auto &e : bucket)
+            if (!next || e.deadline < *next)
+                next = e.deadline;
+    return next;
+}
+
+// ────────────────────────────────────────────────────────────────
+// MotionExecutor
+// ────────────────────────────────────────────────────────────────
+MotionExecutor::MotionExecutor()
+    : wheel_(std::chrono::milliseconds(1), 256) {}
+
+MotionExecutor::~MotionExecutor()
+{
+    stop();
+}
+
+void MotionExecutor::start()
+{
+    if (thread_.joinable())
+        return;
+    stop_ = false;
+    thread_ = std::thread(&MotionExecutor::loop, this);
+    std::string error;
+    if (!applyRtConfig(thread_.native_handle(), config_, error))
+        std::cerr << "Warning: motion executor thread: " << error << std::endl;
+}
+
+std::string MotionExecutor::describeThread()
+{
+    return thread_.joinable() ? ::describeThread(thread_.native_handle()) : std::string();
+}
+
+void MotionExecutor::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    cv_.notify_one();
+    if (thread_.joinable())
+        thread_.join();
+}
+
+void MotionExecutor::post(std::function<void()> fn)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        inbox_.push_back(std::move(fn));
+    }
+    cv_.notify_one();
+}
+
+void MotionExecutor::submit(Script script, Policy policy)
+{
+    if (onExecutorThread())
+    {
+        applySubmit(std::move(script), policy);
+        return;
+    }
+    // std::function needs a copyable closure, so carry the script by shared_ptr
+    auto s = std::make_shared<Script>(std::move(script));
+    post([this, s, policy]()
+         { applySubmit(std::move(*s), policy); });
+}
+
+void MotionExecutor::applySubmit(Script script, Policy policy)
+{
+    switch (policy)
+    {
+    case Policy::PREEMPT:
+        queue_.clear();
+        cancelActive();
+        startScript(std::move(script));
+        break;
+    case Policy::QUEUE:
+        if (active_)
+            queue_.push_back(std::move(script));
+        else
+            startScript(std::move(script));
+        break;
+    case Policy::DROP_IF_BUSY:
+        if (!active_)
+            startScript(std::move(script));
+        break;
+    }
+}
+
+void MotionExecutor::cancelAll()
+{
+    auto cancel = [this]()
+    {
+        queue_.clear();
+        cancelActive();
+    };
+    if (onExecutorThread())
+        cancel();
+    else
+        post(cancel);
+}
+
+void MotionExecutor::cancelIf(std::function<bool(const Script &)> pred)
+{
+    auto cancel = [this, pred = std::move(pred)]()
+    {
+        std::vector<std::function<void()>> cancelled;
+        for (auto it = queue_.begin(); it != queue_.end();)
+        {
+            if (!pred(*it))
+            {
+                ++it;
+                continue;
+            }
+            if (it->on_cancel)
+                cancelled.push_back(std::move(it->on_cancel));
+            it = queue_.erase(it);
+        }
+        for (auto &on_cancel : cancelled)
+            on_cancel();
+
+        if (!active_ || !pred(*active_))
+            return;
+        cancelActive();
+        if (!active_ && !queue_.empty())
+        {
+            Script next = std::move(queue_.front());
+            queue_.pop_front();
+            startScript(std::move(next));
+        }
+    };
+    if (onExecutorThread())
+        cancel();
+    else
+        post(cancel);
+}
+
+uint64_t MotionExecutor::addTimer(Clock::time_point deadline, std::function<void()> fn)
+{
+    const uint64_t id = next_timer_id_.fetch_add(1, std::memory_order_relaxed);
+    wheel_.add(id, deadline, std::move(fn));
+    return id;
+}
+
+uint64_t MotionExecutor::schedule(Clock::duration delay, std::function<void()> fn)
+{
+    const auto deadline = Clock::now() + delay;
+    if (onExecutorThread())
+        return addTimer(deadline, std::move(fn));
+
+    // The wheel is only touched on the executor thread; reserve the id here
+    const uint64_t id = next_timer_id_.fetch_add(1, std::memory_order_relaxed);
+    post([this, id, deadline, fn = std::move(fn)]() mutable
+         { wheel_.add(id, deadline, std::move(fn)); });
+    return id;
+}
+
+void MotionExecutor::cancelTimer(uint64_t id)
+{
+    if (onExecutorThread())
+        wheel_.cancel(id);
+    else
+        post([this, id]()
+             { wheel_.cancel(id); });
+}
+
+void MotionExecutor::loop()
+{
+    if (config_.prefault_stack)
+        prefaultStack();
+
+    std::vector<std::function<void()>> work;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            auto ready = [this]()
+            { return stop_ || !inbox_.empty(); };
+            if (auto next = wheel_.nextDeadline())
+                cv_.wait_until(lock, *next, ready);
+            else
+                cv_.wait(lock, ready);
+            if (stop_)
+                break;
+            work.swap(inbox_);
+        }
+        wheel_.expire(Clock::now(), work);
+
+        for (auto &fn : work)
+            fn();
+        work.clear();
+    }
+
+    // Leave motors in the script's safe state on shutdown
+    queue_.clear();
+    cancelActive();
+}
+
+void MotionExecutor::startScript(Script script)
+{
+    active_ = std::move(script);
+    index_ = 0;
+    ++generation_;
+    busy_ = true;
+    scheduleStep(Clock::now());
+}
+
+void MotionExecutor::scheduleStep(Clock::time_point base)
+{
+    if (index_ >= active_->steps.size())
+    {
+        finishActive();
+        return;
+    }
+    step_due_ = base + active_->steps[index_].delay;
+    step_timer_ = addTimer(step_due_, [this, gen = generation_]()
+                           { onStepDue(gen); });
+}
+
+void MotionExecutor::onStepDue(uint64_t gen)
+{
+    if (gen != generation_ || !active_)
+        return;
+    step_timer_ = 0;
+
+    Step &step = active_->steps[index_];
+    if (step.action)
+        step.action();
+    if (gen != generation_) // the action cancelled or replaced the script
+        return;
+
+    if (step.until)
+    {
+        waiting_ = true;
+        const uint64_t wait = ++wait_seq_;
+        if (step.timeout.count() > 0)
+            wait_timer_ = addTimer(step_due_ + step.timeout, [this, gen, wait]()
+                                   { onWaitTimeout(gen, wait); });
+        checkWait(gen);
+        return;
+    }
+
+    ++index_;
+    scheduleStep(step_due_);
+}
+
+void MotionExecutor::notify()
+{
+    // Pairs with the fence in checkWait(): either that until() sees the state
+    // published before this call, or this load sees waiting_ set
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!waiting_.load(std::memory_order_seq_cst))
+        return;
+    // Coalesce bursts of feedback into one re-check on the executor thread
+    if (notify_pending_.exchange(true, std::memory_order_acq_rel))
+        return;
+    post([this]()
+         {
+        notify_pending_.store(false, std::memory_order_release);
+        if (active_ && waiting_)
+            checkWait(generation_); });
+}
+
+void MotionExecutor::checkWait(uint64_t gen)
+{
+    if (gen != generation_ || !active_ || !waiting_)
+        return;
+    if (poll_timer_)
+        wheel_.cancel(poll_timer_);
+    poll_timer_ = 0;
+
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!active_->steps[index_].until())
+    {
+        // notify() normally wakes us first; the poll covers conditions not tied to feedback
+        poll_timer_ = addTimer(Clock::now() + WAIT_POLL, [this, gen]()
+                               { poll_timer_ = 0; checkWait(gen); });
+        return;
+    }
+
+    waiting_ = false;
+    if (wait_timer_)
+        wheel_.cancel(wait_timer_);
+    wait_timer_ = 0;
+    ++index_;
+    scheduleStep(Clock::now());
+}
+
+void MotionExecutor::onWaitTimeout(uint64_t gen, uint64_t wait)
+{
+    // The wait may have been satisfied in the same wakeup that expired this
+    // timer, after which cancel() no longer finds it; only the current wait counts
+    if (gen != generation_ || !active_ || !waiting_ || wait != wait_seq_)
+        return;
+    wait_timer_ = 0;
+
+    if (active_->steps[index_].continue_on_timeout)
+    {
+        waiting_ = false;
+        if (poll_timer_)
+            wheel_.cancel(poll_timer_);
+        poll_timer_ = 0;
+        if (auto on_timeout = active_->steps[index_].on_timeout)
+            on_timeout();
+        if (gen != generation_) // on_timeout cancelled or replaced the script
+            return;
+        ++index_;
+        scheduleStep(Clock::now());
+        return;
+    }
+
+    clearTimers();
+    auto on_timeout = active_->steps[index_].on_timeout;
+    active_.reset();
+    ++generation_;
+    busy_ = false;
+    if (on_timeout)
+        on_timeout();
+
+    if (!active_ && !queue_.empty())
+    {
+        Script next = std::move(queue_.front());
+        queue_.pop_front();
+        startScript(std::move(next));
+    }
+}
+
+void MotionExecutor::clearTimers()
+{
+    waiting_ = false;
+    for (uint64_t *id : {&step_timer_, &wait_timer_, &poll_timer_})
+    {
+        if (*id)
+            wheel_.cancel(*id);
+        *id = 0;
+    }
+}
+
+void MotionExecutor::cancelActive()
+{
+    if (!active_)
+        return;
+    clearTimers();
+    auto on_cancel = std::move(active_->on_cancel);
+    active_.reset();
+    ++generation_;
+    busy_ = false;
+    if (on_cancel)
+        on_cancel();
+}
+
+void MotionExecutor::finishActive()
+{
+    clearTimers();
+    auto on_done = std::move(active_->on_done);
+    active_.reset();
+    ++generation_;
+    busy_ = false;
+    if (on_done)
+        on_done();
+
+    if (!active_ && !queue_.empty())
+    {
+        Script next = std::move(queue_.front());
+        queue_.pop_front();
+        startScript(std::move(next));
+    }
+}
@@ -1,60 +1,247 @@
 #include <rclcpp/rclcpp.hpp>
-#include "robot_interfaces/srv/control.hpp"
+#include <rclcpp_action/rclcpp_action.hpp>
+#include <rclcpp_components/register_node_macro.hpp>
+#include "robot_interfaces/action/control.hpp"
 #include "robot_interfaces/srv/push_ball.hpp"
 #include "robot_interfaces/srv/request_odrive.hpp"
+#include <diagnostic_msgs/msg/diagnostic_array.hpp>
 #include "odrive_interface/can_comm.hpp"
 #include "odrive_interface/odrive_motor.hpp"
-#include <thread>
+#include "odrive_interface/motion_executor.hpp"
+#include "odrive_interface/trajectory.hpp"
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <ctime>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
 #include <vector>
+#include <array>
 using namespace std;
 using namespace chrono_literals;
-using ControlSrv = robot_interfaces::srv::Control;
+using ControlAction = robot_interfaces::action::Control;
+using ControlGoalHandle = rclcpp_action::ServerGoalHandle<ControlAction>;
 using PushBall = robot_interfaces::srv::PushBall;
 using OdriveSrv = robot_interfaces::srv::RequestOdrive;
+using diagnostic_msgs::msg::DiagnosticArray;
+using diagnostic_msgs::msg::DiagnosticStatus;
+using diagnostic_msgs::msg::KeyValue;
 
 static constexpr float BRACE_ON_POS = 12.0f;
 static constexpr float BRACE_OFF_POS = 0.0f;
+static constexpr float BRACE_POS_EPS = 0.1f; // dung sai coi như brace đã tới đích
+static constexpr auto BRACE_GOAL_TIMEOUT = 3s;
+static constexpr auto PUSH_BALL_TIMEOUT = 1s;
+static constexpr int CANCEL_STATE_RETRIES = 50; // × 1 ms chờ rclcpp đặt goal sang CANCELING
 static const vector<uint8_t> SHOOTER_MOTOR_IDS = {0, 1, 2};
 static const vector<uint8_t> DRIBBLE_MOTOR_IDS = {3, 4};
 static const uint8_t BRACE_MOTOR_ID = 5;
+// Bit của từng cơ cấu trong Script::groups: watchdog chỉ hủy chuỗi điều khiển cơ cấu bị lỗi
+static constexpr uint32_t SHOOTER_GROUP = 1u << 0;
+static constexpr uint32_t DRIBBLE_GROUP = 1u << 1;
+static constexpr uint32_t BRACE_GROUP = 1u << 2;
+static constexpr size_t NUM_MOTORS = 6;
 static constexpr float DRIBBLE_FWD_SPEED = 10.0f;
 static constexpr float DRIBBLE_REV_SPEED = 6.0f;
 static constexpr float DRIBBLE_STOP_SPEED = 0.0f;
 static constexpr auto DRIBBLE_FWD_DUR = 200ms;
 static constexpr auto DRIBBLE_REV_DUR = 2s;
 
+static constexpr uint64_t FEEDBACK_MAX_AGE_NS = 100'000'000; // 100 ms
+
 static constexpr float RELEASE_SPEED = 4.0f;
 static constexpr auto RELEASE_DUR = 800ms;
 
+// Một CANInterface (socket + luồng RX riêng) cho mỗi bus vật lý
+struct CanBus
+{
+  string name;
+  unique_ptr<CANInterface> iface;
+  CANStats last_stats;
+};
+
+// Một goal /control đang chạy, chỉ truy cập trên luồng executor_ (trừ cancel_requested)
+struct ControlGoal
+{
+  shared_ptr<ControlGoalHandle> handle;
+  // đặt ngay trong callback cancel, trước khi rclcpp chuyển goal sang CANCELING
+  atomic<bool> cancel_requested{false};
+  string phase;
+  bool done{false};
+  // goal brace: xong khi feedback tới brace_target, quá deadline thì abort
+  float brace_target{0.0f};
+  chrono::steady_clock::time_point deadline{};
+};
+
 class OdriveInterfaceNode : public rclcpp::Node
 {
 public:
-  OdriveInterfaceNode()
-      : Node("odrive_interface"), brace_on_(false)
+  explicit OdriveInterfaceNode(const rclcpp::NodeOptions &options = rclcpp::NodeOptions())
+      : Node("odrive_interface", options), brace_on_(false)
   {
-    // --- CAN và các OdriveMotor ---
-    can_iface_ = std::make_unique<CANInterface>();
-    if (!can_iface_->openInterface("can0"))
+    // --- Các bus CAN và OdriveMotor ---
+    // can_interface: bus mặc định, "can0" trên robot, "vcan0" khi chạy với odrive_sim_node
+    // motor_can_interfaces[id]: bus của motor id, vd. shooter trên can0, dribble/brace trên can1
+    //   ["can0", "can0", "can0", "can1", "can1", "can1"]; rỗng = mọi motor trên can_interface
+    auto default_can = declare_parameter<string>("can_interface", "can0");
+    auto motor_cans = declare_parameter<vector<string>>("motor_can_interfaces", vector<string>{});
+    if (!motor_cans.empty() && motor_cans.size() != NUM_MOTORS)
     {
-      RCLCPP_FATAL(get_logger(), "Could not open can0");
-      throw runtime_error("CAN init failed");
+      RCLCPP_FATAL(get_logger(), "motor_can_interfaces needs %zu entries, got %zu",
+                   NUM_MOTORS, motor_cans.size());
+      throw runtime_error("Invalid motor_can_interfaces");
     }
+    // --- CAN trace: 0 = tắt (mặc định), 1 = ghi file, 2 = ghi file + in console; đổi được lúc chạy ---
+    // can_trace_format "candump": mỗi bus một file <can_trace_dir>/odrive_<bus>.log (ghi đè mỗi lần chạy)
+    //                  "binary":  <can_trace_dir>/odrive_<bus>_<YYYYmmdd-HHMMSS>.canlog, phát lại bằng odrive_can_replay
+    trace_level_ = declare_parameter<int>("can_trace_level", 0);
+    if (trace_level_ < 0 || trace_level_ > 2)
+    {
+      RCLCPP_FATAL(get_logger(), "can_trace_level must be 0, 1 or 2, got %ld", trace_level_);
+      throw runtime_error("Invalid can_trace_level");
+    }
+    trace_dir_ = declare_parameter<string>("can_trace_dir", "/tmp");
+    auto trace_format = declare_parameter<string>("can_trace_format", "candump");
+    if (trace_format != "candump" && trace_format != "binary")
+    {
+      RCLCPP_FATAL(get_logger(), "can_trace_format must be candump or binary, got %s", trace_format.c_str());
+      throw runtime_error("Invalid can_trace_format");
+    }
+    trace_binary_ = trace_format == "binary";
+    param_cb_ = add_on_set_parameters_callback(
+        bind(&OdriveInterfaceNode::on_set_parameters, this, placeholders::_1));
+
     // khởi tạo 6 motor
-    for (uint8_t id = 0; id < 6; ++id)
+    for (uint8_t id = 0; id < NUM_MOTORS; ++id)
     {
       auto mode = (id < 5
                        ? OdriveMotor::ControlMode::VELOCITY
                        : OdriveMotor::ControlMode::POSITION);
+      const size_t bus = open_bus(motor_cans.empty() ? default_can : motor_cans[id]);
+      motor_bus_.push_back(bus);
       motors_.push_back(
-          std::make_unique<OdriveMotor>(id, mode, can_iface_.get()));
+          std::make_unique<OdriveMotor>(id, mode, buses_[bus].iface.get()));
+      all_group_.push_back(motors_.back().get());
     }
+    for (auto id : SHOOTER_MOTOR_IDS)
+      shooter_group_.push_back(motors_[id].get());
+    for (auto id : DRIBBLE_MOTOR_IDS)
+      dribble_group_.push_back(motors_[id].get());
 
-    // --- Service Server /control ---
-    control_srv_ = create_service<ControlSrv>(
-        "control",
-        bind(&OdriveInterfaceNode::on_control, this,
-             placeholders::_1, placeholders::_2));
+    // --- Bộ lọc CAN trong kernel: chỉ nhận (node đã đăng ký, cmd cần dùng) ---
+    auto recv_own = declare_parameter<bool>("can_recv_own_msgs", false);
+    vector<int64_t> default_rx_cmds(OdriveMotor::RX_CMD_IDS.begin(), OdriveMotor::RX_CMD_IDS.end());
+    auto rx_cmds = declare_parameter<vector<int64_t>>("can_rx_cmd_ids", default_rx_cmds);
+    vector<uint8_t> cmd_ids;
+    for (int64_t cmd : rx_cmds)
+    {
+      // cmd ID ODrive chỉ có 5 bit; ép kiểu sẽ lọc nhầm sang cmd khác
+      if (cmd < 0 || cmd > 0x1F)
+      {
+        RCLCPP_FATAL(get_logger(), "can_rx_cmd_ids entries must be 0..31 (0x00..0x1F), got %ld", cmd);
+        throw runtime_error("Invalid can_rx_cmd_ids");
+      }
+      cmd_ids.push_back(static_cast<uint8_t>(cmd));
+    }
+    for (auto &bus : buses_)
+    {
+      bus.iface->setReceiveOwnMessages(recv_own);
+      if (!cmd_ids.empty() && !bus.iface->applyNodeFilters(cmd_ids))
+        RCLCPP_WARN(get_logger(), "CAN filters not applied on %s, receiving all frames",
+                    bus.name.c_str());
+    }
+
+    // --- Watchdog heartbeat/lỗi ODrive, chạy theo sự kiện từ luồng RX ---
+    // tạo publisher trước khi luồng RX/executor chạy: sự kiện health publish ngay
+    diag_pub_ = create_publisher<DiagnosticArray>("/diagnostics", 10);
+    // watchdog_action: "rearm" = clear lỗi + closed loop lại (tối đa watchdog_max_rearms lần,
+    //   sau đó idle cả nhóm), "idle" = idle cả nhóm motor, "none" = chỉ báo cáo
+    heartbeat_timeout_ = chrono::milliseconds(declare_parameter<int>("heartbeat_timeout_ms", 250));
+    watchdog_action_ = declare_parameter<string>("watchdog_action", "rearm");
+    watchdog_max_rearms_ = static_cast<int>(declare_parameter<int>("watchdog_max_rearms", 3));
+    for (auto &m : motors_)
+    {
+      const uint8_t id = m->getDeviceId();
+      m->setHealthListener([this, id](const OdriveMotor::Health &h)
+                           { executor_.post([this, id, h]()
+                                            { on_health(id, h); }); });
+    }
+
+    // --- Real-time: tách luồng I/O khỏi tải camera/YOLO ---
+    // *_rt_priority: SCHED_FIFO 1..99 (0 = giữ SCHED_OTHER), *_cpus: CPU affinity (rỗng = mọi CPU)
+    // cần CAP_SYS_NICE hoặc rtprio trong /etc/security/limits.conf
+    auto lock_mem = declare_parameter<bool>("rt_lock_memory", false);
+    if (lock_mem)
+    {
+      string err;
+      if (lockMemory(err))
+        RCLCPP_INFO(get_logger(), "Memory locked (mlockall)");
+      else
+        RCLCPP_WARN(get_logger(), "%s", err.c_str());
+    }
+    const auto can_rx_rt = declare_rt_config("can_rx", lock_mem);
+    const auto can_tx_rt = declare_rt_config("can_tx", lock_mem);
+    const auto executor_rt = declare_rt_config("executor", lock_mem);
+
+    // --- Mỗi bus một luồng nhận CAN; OdriveMotor tự đăng ký theo node ID ---
+    // feedback mới đánh thức ngay các bước chờ (until) của executor;
+    // motor bắn còn đếm mẫu trong dung sai ngay trên luồng RX, từng frame một
+    for (auto &m : motors_)
+      m->setFeedbackListener([this]()
+                             { executor_.notify(); });
+    for (size_t i = 0; i < shooter_group_.size(); ++i)
+      shooter_group_[i]->setFeedbackListener([this, i]()
+                                             { count_spin_up_sample(i); executor_.notify(); });
+    for (auto &bus : buses_)
+    {
+      bus.iface->setReceiveThreadConfig(can_rx_rt);
+      if (!bus.iface->startReceiveThread())
+        RCLCPP_ERROR(get_logger(), "Could not start CAN RX thread on %s, no motor feedback",
+                     bus.name.c_str());
+      // Một luồng TX giữ socket: lệnh trạng thái trước, setpoint chỉ giữ giá trị mới nhất
+      bus.iface->setTransmitThreadConfig(can_tx_rt);
+      if (!bus.iface->startTransmitThread())
+        RCLCPP_WARN(get_logger(), "Could not start CAN TX thread on %s, sending from callers",
+                    bus.name.c_str());
+      RCLCPP_INFO(get_logger(), "CAN bus %s ready, RX thread %s, TX thread %s", bus.name.c_str(),
+                  bus.iface->describeReceiveThread().c_str(),
+                  bus.iface->describeTransmitThread().c_str());
+    }
+
+    // --- Quỹ đạo setpoint: tăng tốc trong giới hạn thay vì nhảy thẳng tới đích ---
+    // motor velocity: *_max_accel (turn/s^2), *_max_jerk (turn/s^3, 0 = hình thang)
+    // motor position: *_max_vel (turn/s), *_max_accel (turn/s^2); max_accel/max_vel = 0 thì gửi thẳng
+    auto traj_rate = declare_parameter<double>("traj_rate_hz", 500.0);
+    SetpointProfile::Limits shooter_lim{static_cast<float>(declare_parameter<double>("shooter_max_accel", 150.0)),
+                                        static_cast<float>(declare_parameter<double>("shooter_max_jerk", 1500.0))};
+    SetpointProfile::Limits dribble_lim{static_cast<float>(declare_parameter<double>("dribble_max_accel", 200.0)),
+                                        static_cast<float>(declare_parameter<double>("dribble_max_jerk", 0.0))};
+    SetpointProfile::Limits brace_lim{static_cast<float>(declare_parameter<double>("brace_max_vel", 30.0)),
+                                      static_cast<float>(declare_parameter<double>("brace_max_accel", 150.0))};
+    shooter_traj_ = make_unique<TrajectoryStreamer>(executor_, shooter_group_, shooter_lim, traj_rate);
+    // Mô-men feed-forward = quán tính quy đổi (Nm per turn/s^2) x gia tốc quỹ đạo, 0 = tắt
+    shooter_traj_->setTorqueFeedForward(static_cast<float>(declare_parameter<double>("shooter_torque_ff", 0.0)));
+    dribble_traj_ = make_unique<TrajectoryStreamer>(executor_, dribble_group_, dribble_lim, traj_rate);
+    brace_traj_ = make_unique<TrajectoryStreamer>(executor_, vector<OdriveMotor *>{motors_[BRACE_MOTOR_ID].get()},
+                                                  brace_lim, traj_rate);
+
+    // --- Luồng executor cho các chuỗi dribble/brace/release/shoot ---
+    executor_.setThreadConfig(executor_rt);
+    executor_.start();
+    RCLCPP_INFO(get_logger(), "Motion executor thread %s", executor_.describeThread().c_str());
+    for (uint8_t id = 0; id < NUM_MOTORS; ++id)
+      executor_.post([this, id]()
+                     { arm_heartbeat_timer(id, heartbeat_timeout_); });
+
+    // --- Action Server /control: feedback (pha + vận tốc motor) mỗi control_feedback_ms,
+    //     kết quả khi chuỗi thực sự xong, hủy được giữa chừng ---
+    control_feedback_period_ = chrono::milliseconds(declare_parameter<int>("control_feedback_ms", 100));
+    control_server_ = rclcpp_action::create_server<ControlAction>(
+        this, "control",
+        bind(&OdriveInterfaceNode::on_control_goal, this, placeholders::_1, placeholders::_2),
+        bind(&OdriveInterfaceNode::on_control_cancel, this, placeholders::_1),
+        bind(&OdriveInterfaceNode::on_control_accepted, this, placeholders::_1));
 
     // --- Service Server /request_odrive ---
     odrive_srv_ = create_service<OdriveSrv>(
@@ -64,248 +251,1011 @@ public:
 
     // --- Client cho /push_ball ---
     push_ball_client_ = create_client<PushBall>("push_ball");
+    // bắn khi cả 3 motor trong ±shot_vel_tolerance (turn/s) đủ shot_stable_samples mẫu liên tiếp,
+    // quá shot_spinup_timeout_ms thì vẫn bắn
+    shot_vel_tolerance_ = static_cast<float>(declare_parameter<double>("shot_vel_tolerance", 0.5));
+    shot_stable_samples_ = static_cast<int>(declare_parameter<int>("shot_stable_samples", 3));
+    shot_spinup_timeout_ = chrono::milliseconds(declare_parameter<int>("shot_spinup_timeout_ms", 1500));
+
+    // --- Chẩn đoán: tải bus CAN + độ trễ lệnh→feedback, 1 Hz ---
+    can_bitrate_ = declare_parameter<int>("can_bitrate", 1000000);
+    bus_load_warn_pct_ = declare_parameter<double>("bus_load_warn_pct", 70.0);
+    for (auto &bus : buses_)
+      bus.last_stats = bus.iface->getStats();
+    last_stats_time_ = chrono::steady_clock::now();
+    diag_timer_ = create_wall_timer(1s, bind(&OdriveInterfaceNode::publish_diagnostics, this));
 
     RCLCPP_INFO(get_logger(), "odrive_interface ready.");
   }
 
-  void on_control(const shared_ptr<ControlSrv::Request> req,
-                  shared_ptr<ControlSrv::Response> res)
+  // Tham số <prefix>_rt_priority / <prefix>_cpus cho một luồng I/O
+  RtThreadConfig declare_rt_config(const string &prefix, bool prefault_stack)
   {
-    switch (req->action)
+    RtThreadConfig cfg;
+    cfg.priority = static_cast<int>(declare_parameter<int>(prefix + "_rt_priority", 0));
+    auto cpus = declare_parameter<vector<int64_t>>(prefix + "_cpus", vector<int64_t>{});
+    cfg.cpus.assign(cpus.begin(), cpus.end());
+    cfg.prefault_stack = prefault_stack;
+    return cfg;
+  }
+
+  // Mở bus `name` nếu chưa mở; trả về chỉ số trong buses_
+  size_t open_bus(const string &name)
+  {
+    for (size_t i = 0; i < buses_.size(); ++i)
+      if (buses_[i].name == name)
+        return i;
+
+    CanBus bus;
+    bus.name = name;
+    bus.iface = std::make_unique<CANInterface>();
+    if (!bus.iface->openInterface(name))
     {
-    case 1:
-      action_push_ball(req->velocity);
-      break;
-    case 2:
-      action_toggle_brace();
-      break;
-    case 3:
-      action_dribble();
-      break;
-    case 4:
-      action_auto();
-      break;
-    default:
-      RCLCPP_WARN(get_logger(), "Unknown action %u", req->action);
-      res->success = false;
-      return;
+      RCLCPP_FATAL(get_logger(), "Could not open %s", name.c_str());
+      throw runtime_error("CAN init failed");
     }
-    res->success = true; // nếu tới được đây coi như OK
+    bus.iface->setTraceLevel(static_cast<CANTrace::Level>(trace_level_));
+    string trace_file = trace_dir_ + "/odrive_" + name + ".log";
+    if (trace_binary_)
+    {
+      // mỗi lần chạy một file, log trận trước không bị ghi đè
+      char stamp[32];
+      const time_t t = time(nullptr);
+      struct tm tm;
+      strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", localtime_r(&t, &tm));
+      trace_file = trace_dir_ + "/odrive_" + name + "_" + stamp + ".canlog";
+    }
+    if (!bus.iface->startTrace(trace_file, trace_binary_ ? CANTrace::Format::BINARY : CANTrace::Format::CANDUMP))
+      RCLCPP_WARN(get_logger(), "CAN trace file %s unavailable", trace_file.c_str());
+    else
+      RCLCPP_INFO(get_logger(), "CAN trace %s -> %s", name.c_str(), trace_file.c_str());
+    buses_.push_back(std::move(bus));
+    return buses_.size() - 1;
+  }
+
+  rclcpp_action::GoalResponse on_control_goal(const rclcpp_action::GoalUUID &,
+                                              shared_ptr<const ControlAction::Goal> goal)
+  {
+    if (goal->action < 1 || goal->action > 4)
+    {
+      RCLCPP_WARN(get_logger(), "Unknown action %u", goal->action);
+      return rclcpp_action::GoalResponse::REJECT;
+    }
+    return rclcpp_action::GoalResponse::ACCEPT_AND_EXECUTE;
+  }
+
+  rclcpp_action::CancelResponse on_control_cancel(const shared_ptr<ControlGoalHandle> handle)
+  {
+    {
+      lock_guard<mutex> lock(live_goals_mutex_);
+      auto it = live_goals_.find(handle.get());
+      if (it != live_goals_.end())
+        it->second->cancel_requested.store(true);
+    }
+    executor_.post([this, handle]()
+                   { cancel_goal(handle); });
+    return rclcpp_action::CancelResponse::ACCEPT;
+  }
+
+  // Goal mới chạy trên luồng executor_, PREEMPT goal chuỗi đang chạy (goal đó bị abort)
+  void on_control_accepted(const shared_ptr<ControlGoalHandle> handle)
+  {
+    auto g = make_shared<ControlGoal>();
+    g->handle = handle;
+    g->phase = "accepted";
+    {
+      lock_guard<mutex> lock(live_goals_mutex_);
+      live_goals_[handle.get()] = g;
+    }
+    executor_.post([this, g]()
+                   {
+      track_goal(g);
+      const auto goal = g->handle->get_goal();
+      switch (goal->action)
+      {
+      case 1:
+        action_push_ball(goal->velocity, g);
+        break;
+      case 2:
+        action_toggle_brace(g);
+        break;
+      case 3:
+        action_dribble(g);
+        break;
+      case 4:
+        action_auto(g);
+        break;
+      } });
   }
 
   void on_odrive_request(const shared_ptr<OdriveSrv::Request> req,
                          shared_ptr<OdriveSrv::Response> res)
   {
+    function<void()> cmd;
     switch (req->action)
     {
     case 0:
-      idle();
+      cmd = [this]()
+      { idle(); };
       break;
     case 1:
-      closed_loop_control();
+      cmd = [this]()
+      { closed_loop_control(); };
       break;
     case 3:
-      reset_motors();
+      cmd = [this]()
+      { reset_motors(); };
       break;
     case 4:
-      clear_errors();
+      cmd = [this]()
+      { clear_errors(); };
       break;
     default:
       RCLCPP_WARN(get_logger(), "Unknown action %u", req->action);
       res->success = false;
       return;
     }
+    // Lệnh ODrive hủy mọi chuỗi đang chạy rồi thực thi trên luồng executor
+    executor_.cancelAll();
+    executor_.post(cmd);
     res->success = true; // nếu tới được đây coi như OK
   }
 
+  ~OdriveInterfaceNode() override
+  {
+    executor_.stop();
+    // executor đã dừng: không nhảy thẳng tới đích (shooter đang tăng tốc sẽ quá dòng).
+    // Shooter/dribble thả trôi (IDLE), brace giữ nguyên setpoint đang stream
+    for (auto *t : {shooter_traj_.get(), dribble_traj_.get()})
+      t->stop();
+    OdriveMotor::idleGroup(shooter_group_);
+    OdriveMotor::idleGroup(dribble_group_);
+    brace_traj_->hold();
+    for (auto &bus : buses_)
+    {
+      bus.iface->stopTransmitThread(); // gửi nốt lệnh dừng của on_cancel
+      bus.iface->stopReceiveThread();
+    }
+  }
+
+  rcl_interfaces::msg::SetParametersResult
+  on_set_parameters(const vector<rclcpp::Parameter> &params)
+  {
+    rcl_interfaces::msg::SetParametersResult result;
+    result.successful = true;
+    for (const auto &p : params)
+    {
+      if (p.get_name() != "can_trace_level")
+        continue;
+      auto level = p.as_int();
+      if (level < 0 || level > 2)
+      {
+        result.successful = false;
+        result.reason = "can_trace_level must be 0, 1 or 2";
+        continue;
+      }
+      for (auto &bus : buses_)
+        bus.iface->setTraceLevel(static_cast<CANTrace::Level>(level));
+      RCLCPP_INFO(get_logger(), "CAN trace level = %ld", level);
+    }
+    return result;
+  }
+
+  static KeyValue kv(const string &key, const string &value)
+  {
+    KeyValue k;
+    k.key = key;
+    k.value = value;
+    return k;
+  }
+
+  static string hex32(uint32_t v)
+  {
+    char buf[11];
+    snprintf(buf, sizeof(buf), "0x%08X", v);
+    return buf;
+  }
+
+  // Heartbeat/lỗi, tuổi feedback và độ trễ từ lúc lệnh bước lên socket tới khi feedback đạt giá trị lệnh
+  DiagnosticStatus motor_status(const OdriveMotor &m)
+  {
+    const auto lat = m.getLatency();
+    const auto fb = m.getFeedback();
+    const auto h = m.getHealth();
+    const uint64_t t = CANTrace::monotonicNs();
+    const uint64_t age_ns = fb.ageNs(t);
+    const uint64_t hb_age_ns = h.heartbeatAgeNs(t);
+
+    DiagnosticStatus ms;
+    ms.name = "odrive_interface: motor " + to_string(m.getDeviceId());
+    ms.hardware_id = "odrive_node_" + to_string(m.getDeviceId());
+    ms.level = DiagnosticStatus::OK;
+    ms.message = "OK";
+    if (h.faulted())
+    {
+      ms.level = DiagnosticStatus::ERROR;
+      ms.message = "Axis error";
+    }
+    else if (hb_age_ns > static_cast<uint64_t>(chrono::nanoseconds(heartbeat_timeout_).count()))
+    {
+      ms.level = DiagnosticStatus::ERROR;
+      ms.message = "No heartbeat";
+    }
+    else if (age_ns > FEEDBACK_MAX_AGE_NS)
+    {
+      ms.level = DiagnosticStatus::WARN;
+      ms.message = "No recent feedback";
+    }
+    ms.values.push_back(kv("can_interface", buses_[motor_bus_[m.getDeviceId()]].name));
+    ms.values.push_back(kv("axis_state", axis_state_name(h.axis_state)));
+    ms.values.push_back(kv("axis_error", hex32(h.axis_error)));
+    ms.values.push_back(kv("active_errors", hex32(h.active_errors)));
+    ms.values.push_back(kv("disarm_reason", hex32(h.disarm_reason)));
+    ms.values.push_back(kv("heartbeat_age_ms", hb_age_ns == UINT64_MAX ? "never" : to_string(hb_age_ns / 1000000)));
+    ms.values.push_back(kv("latency_samples", to_string(lat.count)));
+    ms.values.push_back(kv("latency_p50_us", to_string(lat.percentileUs(0.5))));
+    ms.values.push_back(kv("latency_p99_us", to_string(lat.percentileUs(0.99))));
+    ms.values.push_back(kv("latency_mean_us", to_string(lat.meanUs())));
+    ms.values.push_back(kv("latency_max_us", to_string(lat.max_us)));
+    ms.values.push_back(kv("feedback_age_ms", age_ns == UINT64_MAX ? "never" : to_string(age_ns / 1000000)));
+    return ms;
+  }
+
+  // Publish ngay khi trạng thái một motor đổi, không chờ chu kỳ 1 Hz
+  void publish_motor_health(uint8_t id)
+  {
+    DiagnosticArray arr;
+    arr.header.stamp = now();
+    arr.status.push_back(motor_status(*motors_[id]));
+    diag_pub_->publish(arr);
+  }
+
+  // Tải bus và lỗi của một bus kể từ lần publish trước.
+  // Chỉ đếm frame mình gửi + frame RX đã qua filter kernel: tải thật của bus có thể cao hơn.
+  DiagnosticStatus bus_status(CanBus &b, double dt)
+  {
+    const CANStats st = b.iface->getStats();
+    const CANStats &last = b.last_stats;
+    const double fps = (st.tx_frames + st.rx_frames - last.tx_frames - last.rx_frames) / dt;
+    const double bps = (st.tx_bytes + st.rx_bytes - last.tx_bytes - last.rx_bytes) / dt;
+    const double load = 100.0 * (st.tx_bits + st.rx_bits - last.tx_bits - last.rx_bits) /
+                        (dt * static_cast<double>(can_bitrate_));
+    const uint64_t new_tx_err = st.tx_errors - last.tx_errors + st.tx_dropped - last.tx_dropped;
+    const uint64_t new_bus_err = st.bus_errors - last.bus_errors;
+
+    DiagnosticStatus bus;
+    bus.name = "odrive_interface: " + b.name;
+    bus.hardware_id = b.name;
+    if (new_tx_err || new_bus_err)
+    {
+      bus.level = DiagnosticStatus::ERROR;
+      bus.message = "CAN errors";
+    }
+    else if (load > bus_load_warn_pct_)
+    {
+      bus.level = DiagnosticStatus::WARN;
+      bus.message = "High bus load (own TX + filtered RX)";
+    }
+    else
+    {
+      bus.level = DiagnosticStatus::OK;
+      bus.message = "OK";
+    }
+    bus.values.push_back(kv("frames_per_s", to_string(fps)));
+    bus.values.push_back(kv("bytes_per_s", to_string(bps)));
+    bus.values.push_back(kv("own_tx_filtered_rx_load_pct", to_string(load)));
+    bus.values.push_back(kv("bitrate", to_string(can_bitrate_)));
+    bus.values.push_back(kv("tx_frames", to_string(st.tx_frames)));
+    bus.values.push_back(kv("rx_frames", to_string(st.rx_frames)));
+    bus.values.push_back(kv("tx_errors", to_string(st.tx_errors)));
+    bus.values.push_back(kv("bus_errors", to_string(st.bus_errors)));
+    bus.values.push_back(kv("tx_coalesced", to_string(st.tx_coalesced)));
+    bus.values.push_back(kv("tx_dropped", to_string(st.tx_dropped)));
+    bus.values.push_back(kv("tx_blocked", to_string(st.tx_blocked)));
+    b.last_stats = st;
+    return bus;
+  }
+
+  void publish_diagnostics()
+  {
+    const auto t = chrono::steady_clock::now();
+    const double dt = chrono::duration<double>(t - last_stats_time_).count();
+    if (dt <= 0.0)
+      return;
+
+    DiagnosticArray arr;
+    arr.header.stamp = now();
+    for (auto &b : buses_)
+      arr.status.push_back(bus_status(b, dt));
+
+    for (const auto &m : motors_)
+      arr.status.push_back(motor_status(*m));
+
+    diag_pub_->publish(arr);
+    last_stats_time_ = t;
+  }
+
   // ────────────────────────────────────────────────────────────────
   // ⮞ Implementations
   // ────────────────────────────────────────────────────────────────
   void reset_motors()
   {
-    for (int id = 0; id < 6; id++)
-      motors_[id]->setTarget(0.0f);
+    array<float, 3> zeros{};
+    shooter_traj_->setTargets(zeros);
+    dribble_traj_->setTargets(span(zeros).first(DRIBBLE_MOTOR_IDS.size()));
+    set_brace(BRACE_OFF_POS);
     RCLCPP_INFO(get_logger(), "RESET done");
     brace_on_ = false;
   }
 
   void idle()
   {
-    for (int id = 0; id < 6; id++)
-      motors_[id]->idle();
+    OdriveMotor::idleGroup(all_group_);
+    for (auto *t : {shooter_traj_.get(), dribble_traj_.get(), brace_traj_.get()})
+      t->stop();
+    armed_.fill(false);
     RCLCPP_INFO(get_logger(), "Idle done");
   }
 
   void closed_loop_control()
   {
-    for (int id = 0; id < 6; id++)
-      motors_[id]->closeLoopControl();
+    OdriveMotor::closeLoopControlGroup(all_group_);
+    armed_.fill(true);
+    rearm_count_.fill(0);
     RCLCPP_INFO(get_logger(), "Closed loop done");
   }
 
   void clear_errors()
   {
-    for (int id = 0; id < 6; id++)
-      motors_[id]->clearError();
+    OdriveMotor::clearErrorGroup(all_group_);
     RCLCPP_INFO(get_logger(), "Clear errors done");
   }
 
   // ---------------------------------------------------------------
-  void action_push_ball(uint8_t vel)
+  // Watchdog: mọi hàm dưới đây chạy trên luồng executor_
+  // ---------------------------------------------------------------
+  static const char *axis_state_name(uint8_t state)
   {
-    // 1) bắn 0-1-2 ở chế độ velocity
-    for (auto id : SHOOTER_MOTOR_IDS)
-      motors_[id]->setTarget(static_cast<float>(vel));
+    switch (state)
+    {
+    case OdriveMotor::AXIS_STATE_UNDEFINED:
+      return "UNDEFINED";
+    case OdriveMotor::AXIS_STATE_IDLE:
+      return "IDLE";
+    case OdriveMotor::AXIS_STATE_FULL_CALIBRATION:
+      return "FULL_CALIBRATION";
+    case OdriveMotor::AXIS_STATE_CLOSED_LOOP:
+      return "CLOSED_LOOP";
+    case OdriveMotor::AXIS_STATE_HOMING:
+      return "HOMING";
+    default:
+      return "OTHER";
+    }
+  }
+
+  // Nhóm cơ cấu chứa motor: shooter, dribble hoặc riêng motor đó
+  vector<OdriveMotor *> group_of(uint8_t id)
+  {
+    auto in = [id](const vector<uint8_t> &ids)
+    { return find(ids.begin(), ids.end(), id) != ids.end(); };
+    if (in(SHOOTER_MOTOR_IDS))
+      return shooter_group_;
+    if (in(DRIBBLE_MOTOR_IDS))
+      return dribble_group_;
+    return {motors_[id].get()};
+  }
 
-    // 2) sau 0.5 s gọi /push_ball – không block
-    thread([this]()
-           {
-      this_thread::sleep_for(500ms);
+  uint32_t group_bit_of(uint8_t id)
+  {
+    auto in = [id](const vector<uint8_t> &ids)
+    { return find(ids.begin(), ids.end(), id) != ids.end(); };
+    if (in(SHOOTER_MOTOR_IDS))
+      return SHOOTER_GROUP;
+    if (in(DRIBBLE_MOTOR_IDS))
+      return DRIBBLE_GROUP;
+    return BRACE_GROUP;
+  }
 
-      auto req  = std::make_shared<PushBall::Request>();
-      req->wait_for_completion = true;
+  TrajectoryStreamer *traj_of(uint8_t id)
+  {
+    auto in = [id](const vector<uint8_t> &ids)
+    { return find(ids.begin(), ids.end(), id) != ids.end(); };
+    if (in(SHOOTER_MOTOR_IDS))
+      return shooter_traj_.get();
+    if (in(DRIBBLE_MOTOR_IDS))
+      return dribble_traj_.get();
+    return brace_traj_.get();
+  }
 
-      if (!push_ball_client_->wait_for_service(1s)) {
-      RCLCPP_ERROR(get_logger(), "/push_ball service unavailable");
+  void idle_group_of(uint8_t id, const char *reason)
+  {
+    auto group = group_of(id);
+    const uint32_t bit = group_bit_of(id);
+    // Chỉ hủy chuỗi/goal đang điều khiển nhóm này, cơ cấu khác chạy tiếp
+    executor_.cancelIf([bit](const Script &s)
+                       { return (s.groups & bit) != 0; });
+    if (bit == BRACE_GROUP && brace_goal_)
+      finish_goal(brace_goal_, false, "brace motor idled by watchdog");
+    traj_of(id)->stop();
+    OdriveMotor::idleGroup(group);
+    for (auto *m : group)
+      armed_[m->getDeviceId()] = false;
+    RCLCPP_ERROR(get_logger(), "Watchdog: motor %u %s, idled its group (%zu motors)",
+                 id, reason, group.size());
+  }
+
+  // Heartbeat/lỗi thay đổi (đã lọc trên luồng RX, không phải mỗi heartbeat)
+  void on_health(uint8_t id, const OdriveMotor::Health &h)
+  {
+    if (hb_lost_[id])
+    {
+      hb_lost_[id] = false;
+      RCLCPP_INFO(get_logger(), "Motor %u heartbeat back", id);
+    }
+    publish_motor_health(id);
+
+    if (h.faulted())
+      RCLCPP_WARN(get_logger(), "Motor %u %s, axis_error=0x%08X active_errors=0x%08X disarm=0x%08X",
+                  id, axis_state_name(h.axis_state), h.axis_error, h.active_errors, h.disarm_reason);
+    if (!armed_[id] || watchdog_action_ == "none")
+      return;
+    if (h.closedLoop() && !h.faulted())
+    {
+      rearm_count_[id] = 0;
+      return;
+    }
+    // Đang chuyển trạng thái (calibration/homing...) thì chưa can thiệp
+    if (h.axis_state != OdriveMotor::AXIS_STATE_IDLE && !h.faulted())
       return;
+
+    if (watchdog_action_ == "rearm" && rearm_count_[id] < watchdog_max_rearms_)
+    {
+      ++rearm_count_[id];
+      motors_[id]->clearError();
+      motors_[id]->closeLoopControl();
+      RCLCPP_WARN(get_logger(), "Watchdog: motor %u dropped out of closed loop, re-arming (%d/%d)",
+                  id, rearm_count_[id], watchdog_max_rearms_);
+      return;
+    }
+    idle_group_of(id, "dropped out of closed loop");
+  }
+
+  // Hẹn giờ đúng hạn heartbeat kế tiếp; heartbeat đến trước thì chỉ dời hạn, không polling
+  void arm_heartbeat_timer(uint8_t id, chrono::nanoseconds delay)
+  {
+    executor_.schedule(delay, [this, id]()
+                       { check_heartbeat(id); });
+  }
+
+  void check_heartbeat(uint8_t id)
+  {
+    const auto h = motors_[id]->getHealth();
+    const uint64_t age = h.heartbeatAgeNs(CANTrace::monotonicNs());
+    const auto timeout_ns = static_cast<uint64_t>(chrono::nanoseconds(heartbeat_timeout_).count());
+    if (age < timeout_ns)
+    {
+      // on_health chỉ chạy khi heartbeat đổi nội dung: motor về lại cùng trạng thái thì phải xóa cờ ở đây
+      if (hb_lost_[id])
+      {
+        hb_lost_[id] = false;
+        RCLCPP_INFO(get_logger(), "Motor %u heartbeat back", id);
+        publish_motor_health(id);
       }
-      push_ball_client_->async_send_request(req);
-      RCLCPP_INFO(get_logger(), "Called /push_ball (async)"); })
-        .detach();
+      arm_heartbeat_timer(id, chrono::nanoseconds(timeout_ns - age));
+      return;
+    }
+    if (!hb_lost_[id])
+    {
+      hb_lost_[id] = true;
+      publish_motor_health(id);
+      if (armed_[id] && watchdog_action_ != "none")
+        idle_group_of(id, "heartbeat lost");
+      else
+        RCLCPP_WARN(get_logger(), "Motor %u: no heartbeat for %ld ms", id,
+                    static_cast<long>(heartbeat_timeout_.count()));
+    }
+    arm_heartbeat_timer(id, heartbeat_timeout_);
+  }
+
+  // Motor lẻ quay +speed, motor chẵn quay -speed (một lệnh sendmmsg)
+  void set_dribble(float speed)
+  {
+    array<float, 2> targets;
+    for (size_t i = 0; i < DRIBBLE_MOTOR_IDS.size(); ++i)
+      targets[i] = speed * ((DRIBBLE_MOTOR_IDS[i] % 2) ? 1.f : -1.f);
+    dribble_traj_->setTargets(targets);
+  }
+
+  // Brace chạy quỹ đạo vị trí hình thang
+  void set_brace(float pos)
+  {
+    brace_traj_->setTargets(span(&pos, 1));
   }
 
   // ---------------------------------------------------------------
-  void action_toggle_brace()
+  // Mọi chuỗi chuyển động chạy trên executor_: một luồng duy nhất, lệnh mới
+  // PREEMPT chuỗi đang chạy (on_cancel đưa motor về trạng thái an toàn).
+  // ---------------------------------------------------------------
+  using Script = MotionExecutor::Script;
+  using Step = MotionExecutor::Step;
+
+  static Step step(chrono::nanoseconds delay, function<void()> action)
   {
-    float target = (brace_on_ ? BRACE_OFF_POS : BRACE_ON_POS);
-    motors_[BRACE_MOTOR_ID]->setTarget(target);
-    brace_on_ = !brace_on_;
-    RCLCPP_INFO(get_logger(), "Brace %s (pos=%.1f)",
-                brace_on_ ? "ON" : "OFF", target);
+    Step s;
+    s.delay = delay;
+    s.action = std::move(action);
+    return s;
   }
 
   // ---------------------------------------------------------------
-  void action_release()
+  // Goal /control, chỉ chạy trên luồng executor_
+  // ---------------------------------------------------------------
+  void track_goal(const shared_ptr<ControlGoal> &g)
   {
-    thread([this]()
-           {
-    for (auto id : DRIBBLE_MOTOR_IDS)
-      motors_[id]->setTarget(RELEASE_SPEED * ((id % 2) ? 1.f : -1.f));
+    goals_.push_back(g);
+    if (!feedback_timer_)
+      feedback_timer_ = executor_.schedule(control_feedback_period_, [this]()
+                                           { goal_feedback_tick(); });
+  }
 
-    this_thread::sleep_for(RELEASE_DUR);
+  // Đổi pha và báo ngay, không chờ chu kỳ feedback
+  void set_phase(const shared_ptr<ControlGoal> &g, const char *phase)
+  {
+    g->phase = phase;
+    publish_goal_feedback(*g);
+  }
 
-    // Stop dribble motors
-    for (auto id : DRIBBLE_MOTOR_IDS)
-      motors_[id]->setTarget(DRIBBLE_STOP_SPEED);
+  void publish_goal_feedback(const ControlGoal &g)
+  {
+    auto fb = make_shared<ControlAction::Feedback>();
+    fb->phase = g.phase;
+    fb->velocities.reserve(NUM_MOTORS);
+    for (auto &m : motors_)
+      fb->velocities.push_back(m->getFeedback().velocity);
+    g.handle->publish_feedback(fb);
+  }
+
+  // Kết thúc goal đúng một lần: canceled nếu client đã xin hủy, còn lại succeed/abort
+  void finish_goal(shared_ptr<ControlGoal> g, bool success, const string &message)
+  {
+    if (g->done)
+      return;
+    g->done = true;
+    goals_.erase(remove(goals_.begin(), goals_.end(), g), goals_.end());
+    if (script_goal_ == g)
+      script_goal_.reset();
+    if (brace_goal_ == g)
+      brace_goal_.reset();
+    {
+      lock_guard<mutex> lock(live_goals_mutex_);
+      live_goals_.erase(g->handle.get());
+    }
+    if (!rclcpp::ok()) // đang tắt node (executor_.stop() hủy chuỗi): không còn gửi được kết quả
+      return;
+    auto res = make_shared<ControlAction::Result>();
+    res->success = success;
+    res->message = message;
+    send_goal_result(g, res, 0);
+  }
+
+  // Client đã xin hủy: trả canceled. rclcpp chỉ chuyển goal sang CANCELING sau khi
+  // on_control_cancel trả về, nên chờ bước đó (vài ms) rồi mới gọi canceled()
+  void send_goal_result(const shared_ptr<ControlGoal> &g, const shared_ptr<ControlAction::Result> &res, int attempt)
+  {
+    if (!rclcpp::ok())
+      return;
+    if (g->cancel_requested.load())
+    {
+      if (g->handle->is_canceling())
+      {
+        g->handle->canceled(res);
+        return;
+      }
+      if (attempt < CANCEL_STATE_RETRIES)
+      {
+        executor_.schedule(chrono::milliseconds(1), [this, g, res, attempt]()
+                           { send_goal_result(g, res, attempt + 1); });
+        return;
+      }
+    }
+    if (res->success)
+      g->handle->succeed(res);
+    else
+      g->handle->abort(res);
+  }
+
+  void cancel_goal(const shared_ptr<ControlGoalHandle> &handle)
+  {
+    if (script_goal_ && script_goal_->handle == handle)
+    {
+      executor_.cancelAll(); // on_cancel của chuỗi dừng motor rồi trả kết quả
+      return;
+    }
+    // goal brace: brace vẫn chạy tới đích, dừng giữa chừng không kẹp được bóng
+    for (auto &g : goals_)
+      if (g->handle == handle)
+      {
+        finish_goal(g, false, "cancelled");
+        return;
+      }
+  }
 
-    RCLCPP_INFO(get_logger(), "Release sequence done"); })
-        .detach();
+  // Chạy chuỗi cho goal g: xong → succeed, bị hủy/ngắt (PREEMPT, watchdog, /request_odrive) → canceled/abort
+  void start_script(Script s, const shared_ptr<ControlGoal> &g)
+  {
+    s.on_done = [this, g, name = s.name, on_done = std::move(s.on_done)]()
+    {
+      if (on_done)
+        on_done();
+      finish_goal(g, true, name + " done");
+    };
+    s.on_cancel = [this, g, on_cancel = std::move(s.on_cancel)]()
+    {
+      if (on_cancel)
+        on_cancel();
+      finish_goal(g, false, g->cancel_requested.load() ? "cancelled" : "interrupted");
+    };
+    // Bước until hết hạn mà không đi tiếp thì chuỗi kết thúc không qua on_done/on_cancel:
+    // goal vẫn phải có kết quả, nếu on_timeout của bước chưa trả thì abort ở đây
+    for (auto &step : s.steps)
+    {
+      if (!step.until || step.continue_on_timeout)
+        continue;
+      step.on_timeout = [this, g, name = s.name, on_timeout = std::move(step.on_timeout)]()
+      {
+        if (on_timeout)
+          on_timeout();
+        finish_goal(g, false, name + " timed out");
+      };
+    }
+    auto previous = script_goal_;
+    script_goal_ = g;
+    executor_.submit(std::move(s), MotionExecutor::Policy::PREEMPT);
+    // PREEMPT đã chạy on_cancel của chuỗi trước; goal của nó vẫn chưa có kết quả thì kết thúc ở đây
+    if (previous && previous != g)
+      finish_goal(previous, false, "interrupted");
+  }
+
+  void goal_feedback_tick()
+  {
+    feedback_timer_ = 0;
+    // Goal brace xong khi quỹ đạo đã hết và feedback vị trí tới đích
+    if (auto g = brace_goal_)
+    {
+      const auto fb = motors_[BRACE_MOTOR_ID]->getFeedback();
+      const bool fresh = fb.ageNs(CANTrace::monotonicNs()) < FEEDBACK_MAX_AGE_NS;
+      if (!brace_traj_->active() && fresh && abs(fb.position - g->brace_target) < BRACE_POS_EPS)
+        finish_goal(g, true, "brace in position");
+      else if (chrono::steady_clock::now() > g->deadline)
+        finish_goal(g, false, "brace did not reach its target");
+    }
+    for (auto &g : goals_)
+      publish_goal_feedback(*g);
+    if (!goals_.empty())
+      feedback_timer_ = executor_.schedule(control_feedback_period_, [this]()
+                                           { goal_feedback_tick(); });
   }
 
   // ---------------------------------------------------------------
-  void action_dribble()
+  // Luồng CAN RX, sau mỗi frame feedback của motor bắn thứ i: cập nhật chuỗi mẫu liên tiếp
+  // trong dung sai của lần bắn đang đếm (mẫu nhận trước khi gửi lệnh không tính)
+  void count_spin_up_sample(size_t i)
+  {
+    const uint32_t epoch = spin_up_epoch_.load(memory_order_acquire);
+    if (epoch == 0)
+      return;
+    const auto fb = shooter_group_[i]->getFeedback();
+    if (fb.timestamp_ns <= spin_up_cmd_ns_.load(memory_order_relaxed))
+      return;
+    const uint64_t word = spin_up_streak_[i].load(memory_order_relaxed);
+    const uint32_t prev = (word >> 32) == epoch ? static_cast<uint32_t>(word) : 0;
+    const bool in_tol = abs(fb.velocity - spin_up_target_.load(memory_order_relaxed)) <= shot_vel_tolerance_;
+    spin_up_streak_[i].store((static_cast<uint64_t>(epoch) << 32) | (in_tol ? prev + 1 : 0), memory_order_release);
+  }
+
+  // Chuỗi mẫu của lần bắn hiện tại (0 nếu motor chưa có mẫu nào của lần này)
+  int spin_up_streak(size_t i) const
+  {
+    const uint64_t word = spin_up_streak_[i].load(memory_order_acquire);
+    return (word >> 32) == spin_up_epoch_.load(memory_order_relaxed) ? static_cast<int>(static_cast<uint32_t>(word)) : 0;
+  }
+
+  void action_push_ball(uint8_t vel, const shared_ptr<ControlGoal> &g)
   {
-    if (!brace_on_)
+    struct SpinUp
+    {
+      uint64_t cmd_ns{0};
+      // kết quả /push_ball: 0 chưa có, 1 OK, -1 lỗi (ghi từ luồng ROS)
+      atomic<int> pushed{0};
+    };
+    auto su = make_shared<SpinUp>();
+    const float target = static_cast<float>(vel);
+
+    Script s;
+    s.name = "push_ball";
+    s.groups = SHOOTER_GROUP;
+    // 1) bắn 0-1-2 ở chế độ velocity
+    s.steps.push_back(step(0ms, [this, g, su, target]()
+                           {
+      array<float, 3> targets;
+      targets.fill(target);
+      su->cmd_ns = CANTrace::monotonicNs();
+      // epoch mới làm mọi chuỗi cũ về 0; target/cmd_ns ghi trước khi công bố epoch
+      spin_up_target_.store(target, memory_order_relaxed);
+      spin_up_cmd_ns_.store(su->cmd_ns, memory_order_relaxed);
+      spin_up_epoch_.store(++spin_up_seq_, memory_order_release);
+      shooter_traj_->setTargets(targets);
+      set_phase(g, "spin_up"); }));
+    // 2) chờ cả 3 motor đạt tốc độ (shot_stable_samples mẫu liên tiếp); chuỗi đếm trên luồng RX
+    //    theo từng frame, nên vài frame dồn vào một lần kiểm tra vẫn được tính đủ
+    Step wait;
+    wait.until = [this]()
     {
-      action_release();
+      for (size_t i = 0; i < shooter_group_.size(); ++i)
+        if (spin_up_streak(i) < shot_stable_samples_)
+          return false;
+      return true;
+    };
+    wait.timeout = shot_spinup_timeout_;
+    // hết giờ vẫn bắn, nhưng báo để chỉnh lại tham số/kiểm tra motor
+    wait.continue_on_timeout = true;
+    wait.on_timeout = [this]()
+    {
+      RCLCPP_WARN(get_logger(), "Shooter spin-up timeout (streaks %d/%d/%d), pushing anyway",
+                  spin_up_streak(0), spin_up_streak(1), spin_up_streak(2));
+    };
+    s.steps.push_back(std::move(wait));
+    // 3) gọi /push_ball ngay khi đạt tốc độ – không block executor
+    s.steps.push_back(step(0ms, [this, g, su]()
+                           {
+      spin_up_epoch_.store(0, memory_order_relaxed);
+      RCLCPP_INFO(get_logger(), "Pushing ball %.1f ms after spin-up command",
+                  (CANTrace::monotonicNs() - su->cmd_ns) / 1e6);
+      set_phase(g, "push");
+      call_push_ball(shared_ptr<atomic<int>>(su, &su->pushed)); }));
+    // 4) goal xong khi MCU đã nhận lệnh đẩy bóng
+    Step pushed;
+    pushed.until = [su]()
+    { return su->pushed.load(memory_order_acquire) != 0; };
+    pushed.timeout = PUSH_BALL_TIMEOUT;
+    pushed.on_timeout = [this, g]()
+    { finish_goal(g, false, "/push_ball did not respond"); };
+    s.steps.push_back(std::move(pushed));
+    s.on_done = [this, g, su]()
+    {
+      if (su->pushed.load(memory_order_acquire) < 0)
+        finish_goal(g, false, "/push_ball failed");
+    };
+    start_script(std::move(s), g);
+  }
+
+  // Gọi /push_ball không block; *result = 1 (OK) hoặc -1 (lỗi), rồi đánh thức executor
+  void call_push_ball(shared_ptr<atomic<int>> result)
+  {
+    if (!push_ball_client_->service_is_ready())
+    {
+      RCLCPP_ERROR(get_logger(), "/push_ball service unavailable");
+      result->store(-1, memory_order_release);
       return;
     }
-    // Chạy trong thread riêng để callback /control không block
-    thread([this]()
-           {
-    // 1. Forward 200 ms
-      for (auto id : DRIBBLE_MOTOR_IDS)
-      motors_[id]->setTarget(DRIBBLE_FWD_SPEED * ((id % 2) ? 1.f : -1.f));
-      this_thread::sleep_for(DRIBBLE_FWD_DUR);
+    auto req = std::make_shared<PushBall::Request>();
+    req->wait_for_completion = true;
+    push_ball_client_->async_send_request(
+        req, [this, result](rclcpp::Client<PushBall>::SharedFuture f)
+        {
+          result->store(f.get()->success ? 1 : -1, memory_order_release);
+          executor_.notify(); });
+    RCLCPP_INFO(get_logger(), "Called /push_ball (async)");
+  }
 
-      // 2. Reverse 2 s
-      for (auto id : DRIBBLE_MOTOR_IDS)
-      motors_[id]->setTarget(DRIBBLE_REV_SPEED * ((id % 2) ? -1.f :  1.f));
-      this_thread::sleep_for(DRIBBLE_REV_DUR);
+  // ---------------------------------------------------------------
+  // Brace không chiếm executor: dribble đang chạy vẫn tiếp tục
+  void action_toggle_brace(const shared_ptr<ControlGoal> &g)
+  {
+    float target = (brace_on_ ? BRACE_OFF_POS : BRACE_ON_POS);
+    set_brace(target);
+    brace_on_ = !brace_on_;
+    RCLCPP_INFO(get_logger(), "Brace %s (pos=%.1f)",
+                brace_on_ ? "ON" : "OFF", target);
 
-      // 3. Stop
-      for (auto id : DRIBBLE_MOTOR_IDS)
-      motors_[id]->setTarget(DRIBBLE_STOP_SPEED);
+    if (brace_goal_)
+      finish_goal(brace_goal_, false, "superseded by a new brace goal");
+    brace_goal_ = g;
+    g->brace_target = target;
+    g->deadline = chrono::steady_clock::now() + BRACE_GOAL_TIMEOUT;
+    set_phase(g, brace_on_ ? "brace_on" : "brace_off");
+  }
 
-      RCLCPP_INFO(get_logger(), "Dribble sequence done"); })
-        .detach();
+  // ---------------------------------------------------------------
+  Script release_script(const shared_ptr<ControlGoal> &g)
+  {
+    Script s;
+    s.name = "release";
+    s.groups = DRIBBLE_GROUP;
+    s.steps.push_back(step(0ms, [this, g]()
+                           {
+      set_phase(g, "release");
+      set_dribble(RELEASE_SPEED); }));
+    s.steps.push_back(step(RELEASE_DUR, [this]()
+                           {
+      set_dribble(DRIBBLE_STOP_SPEED);
+      RCLCPP_INFO(get_logger(), "Release sequence done"); }));
+    s.on_cancel = [this]()
+    { set_dribble(DRIBBLE_STOP_SPEED); };
+    return s;
+  }
+
+  Script dribble_script(const shared_ptr<ControlGoal> &g)
+  {
+    Script s;
+    s.name = "dribble";
+    s.groups = DRIBBLE_GROUP;
+    // 1. Forward 200 ms
+    s.steps.push_back(step(0ms, [this, g]()
+                           {
+      set_phase(g, "dribble_forward");
+      set_dribble(DRIBBLE_FWD_SPEED); }));
+    // 2. Reverse 2 s
+    s.steps.push_back(step(DRIBBLE_FWD_DUR, [this, g]()
+                           {
+      set_phase(g, "dribble_reverse");
+      set_dribble(-DRIBBLE_REV_SPEED); }));
+    // 3. Stop
+    s.steps.push_back(step(DRIBBLE_REV_DUR, [this]()
+                           {
+      set_dribble(DRIBBLE_STOP_SPEED);
+      RCLCPP_INFO(get_logger(), "Dribble sequence done"); }));
+    s.on_cancel = [this]()
+    { set_dribble(DRIBBLE_STOP_SPEED); };
+    return s;
+  }
+
+  void action_dribble(const shared_ptr<ControlGoal> &g)
+  {
+    start_script(brace_on_ ? dribble_script(g) : release_script(g), g);
   }
 
   // ---------------------------------------------------------------
-  void action_auto()
+  void action_auto(const shared_ptr<ControlGoal> &g)
   {
-    thread([this]()
-           {
+    start_script(auto_script(g), g);
+  }
+
+  Script auto_script(const shared_ptr<ControlGoal> &g)
+  {
+    Script s;
+    s.name = "auto";
+    s.groups = DRIBBLE_GROUP | BRACE_GROUP;
+
     /**************** 1. BRACE ON nếu chưa ****************/
-    if (!brace_on_) {
-      motors_[BRACE_MOTOR_ID]->setTarget(BRACE_ON_POS);
+    const bool need_brace = !brace_on_;
+    s.steps.push_back(step(0ms, [this, g, need_brace]()
+                           {
+      set_phase(g, "brace_on");
+      if (!need_brace) return;
+      set_brace(BRACE_ON_POS);
       brace_on_ = true;                       // cập nhật cờ
-      RCLCPP_INFO(get_logger(), "Auto: brace ON");
-      this_thread::sleep_for(200ms);     // cho cơ cấu ổn định một chút
-    }
+      RCLCPP_INFO(get_logger(), "Auto: brace ON"); }));
 
     /**************** 2. DRIBBLE (nhồi 2 s) ****************/
-    // forward 0,2 s
-    for (auto id : DRIBBLE_MOTOR_IDS)
-      motors_[id]->setTarget(DRIBBLE_FWD_SPEED * ((id % 2) ? 1.f : -1.f));
-    this_thread::sleep_for(DRIBBLE_FWD_DUR);
-
+    // forward 0,2 s (sau 200 ms cho cơ cấu ổn định nếu vừa bật brace)
+    s.steps.push_back(step(need_brace ? chrono::nanoseconds(200ms) : chrono::nanoseconds(0), [this, g]()
+                           {
+      set_phase(g, "dribble_forward");
+      set_dribble(DRIBBLE_FWD_SPEED); }));
     // reverse 2 s
-    for (auto id : DRIBBLE_MOTOR_IDS)
-      motors_[id]->setTarget(DRIBBLE_REV_SPEED * ((id % 2) ? -1.f : 1.f));
-    this_thread::sleep_for(DRIBBLE_REV_DUR);        // tổng ≈ 2 s
+    s.steps.push_back(step(DRIBBLE_FWD_DUR, [this, g]()
+                           {
+      set_phase(g, "dribble_reverse");
+      set_dribble(-DRIBBLE_REV_SPEED); }));
 
     /**************** 3. BRACE OFF ****************/
-    motors_[BRACE_MOTOR_ID]->setTarget(BRACE_OFF_POS);
-    brace_on_ = false;
-    RCLCPP_INFO(get_logger(), "Auto: brace OFF ⇒ chờ về vị trí 0");
+    s.steps.push_back(step(DRIBBLE_REV_DUR, [this, g]()
+                           {
+      set_phase(g, "brace_off");
+      set_brace(BRACE_OFF_POS);
+      brace_on_ = false;
+      RCLCPP_INFO(get_logger(), "Auto: brace OFF ⇒ chờ về vị trí 0"); }));
 
     /**************** 4. Đợi feedback vị trí = 0 ****************/
-    constexpr float POS_EPS = 0.1f;                  // dung sai
-    const auto      TIMEOUT = 5s;                    // tránh kẹt
-    auto            start   = chrono::steady_clock::now();
-
-    while (true) {
-      float pos = motors_[BRACE_MOTOR_ID]->getPosition();  
-      if (abs(pos - BRACE_OFF_POS) < POS_EPS) break;
-      if (chrono::steady_clock::now() - start > TIMEOUT) {
-        RCLCPP_ERROR(get_logger(), "Auto: brace never reached 0 !");
-        return;   // hủy quy trình
-      }
-      this_thread::sleep_for(50ms);
-    }
+    // được đánh giá lại trên mỗi frame feedback (không polling 50 ms)
+    Step wait;
+    wait.until = [this]()
+    {
+      // chỉ tin feedback còn mới (tránh vị trí cũ từ trước khi brace chạy)
+      auto fb = motors_[BRACE_MOTOR_ID]->getFeedback();
+      bool fresh = fb.ageNs(CANTrace::monotonicNs()) < FEEDBACK_MAX_AGE_NS;
+      return fresh && abs(fb.position - BRACE_OFF_POS) < BRACE_POS_EPS;
+    };
+    wait.timeout = 5s; // tránh kẹt
+    wait.on_timeout = [this, g]()
+    {
+      set_dribble(DRIBBLE_STOP_SPEED);
+      RCLCPP_ERROR(get_logger(), "Auto: brace never reached 0 !");
+      finish_goal(g, false, "brace never reached 0");
+    };
+    s.steps.push_back(std::move(wait));
 
-    /**************** 5. RELEASE (speed = 4 trong 0,4 s) ****************/
-    RCLCPP_INFO(get_logger(), "Auto: release");
-    for (auto id : DRIBBLE_MOTOR_IDS)
-      motors_[id]->setTarget(RELEASE_SPEED * ((id % 2) ? 1.f : -1.f));
-    this_thread::sleep_for(RELEASE_DUR);
-    for (auto id : DRIBBLE_MOTOR_IDS)
-      motors_[id]->setTarget(DRIBBLE_STOP_SPEED);
+    /**************** 5. RELEASE (speed = 4 trong 0,8 s) ****************/
+    s.steps.push_back(step(0ms, [this, g]()
+                           {
+      set_phase(g, "release");
+      RCLCPP_INFO(get_logger(), "Auto: release");
+      set_dribble(RELEASE_SPEED); }));
+    s.steps.push_back(step(RELEASE_DUR, [this]()
+                           {
+      set_dribble(DRIBBLE_STOP_SPEED);
+      RCLCPP_INFO(get_logger(), "Auto: sequence DONE"); }));
 
-    RCLCPP_INFO(get_logger(), "Auto: sequence DONE"); })
-        .detach();
+    s.on_cancel = [this]()
+    { set_dribble(DRIBBLE_STOP_SPEED); };
+    return s;
   }
 
   // ────────────────────────────────────────────────────────────────
   // Private data
   // ────────────────────────────────────────────────────────────────
 private:
-  unique_ptr<CANInterface> can_iface_;
+  vector<CanBus> buses_;
+  vector<size_t> motor_bus_; // motor id -> chỉ số trong buses_
+  int64_t trace_level_;
+  string trace_dir_;
+  bool trace_binary_;
   vector<unique_ptr<OdriveMotor>> motors_;
-  rclcpp::Service<ControlSrv>::SharedPtr control_srv_;
+  vector<OdriveMotor *> all_group_;
+  vector<OdriveMotor *> shooter_group_;
+  vector<OdriveMotor *> dribble_group_;
+  // Hủy trước motors_/buses_ để on_cancel còn gửi được lệnh dừng
+  MotionExecutor executor_;
+  // Chỉ dùng trên luồng executor_ (stop()/hold() trong destructor sau khi executor dừng)
+  unique_ptr<TrajectoryStreamer> shooter_traj_;
+  unique_ptr<TrajectoryStreamer> dribble_traj_;
+  unique_ptr<TrajectoryStreamer> brace_traj_;
+  rclcpp_action::Server<ControlAction>::SharedPtr control_server_;
   rclcpp::Service<OdriveSrv>::SharedPtr odrive_srv_;
   rclcpp::Client<PushBall>::SharedPtr push_ball_client_;
-  bool brace_on_;
+  rclcpp::node_interfaces::OnSetParametersCallbackHandle::SharedPtr param_cb_;
+  rclcpp::Publisher<DiagnosticArray>::SharedPtr diag_pub_;
+  rclcpp::TimerBase::SharedPtr diag_timer_;
+  chrono::steady_clock::time_point last_stats_time_;
+  int64_t can_bitrate_;
+  double bus_load_warn_pct_;
+  bool brace_on_; // chỉ truy cập trên luồng executor_
+
+  // Điều kiện bắn (chỉ đọc sau khi khởi tạo)
+  float shot_vel_tolerance_;
+  int shot_stable_samples_;
+  chrono::milliseconds shot_spinup_timeout_;
+
+  // Đếm mẫu spin-up: executor công bố lần bắn (epoch != 0), luồng CAN RX đếm từng frame.
+  // Mỗi phần tử streak = epoch << 32 | số mẫu liên tiếp trong dung sai của motor bắn đó
+  atomic<uint32_t> spin_up_epoch_{0};
+  uint32_t spin_up_seq_{0}; // chỉ luồng executor_
+  atomic<float> spin_up_target_{0.0f};
+  atomic<uint64_t> spin_up_cmd_ns_{0};
+  array<atomic<uint64_t>, 3> spin_up_streak_{};
+
+  // Goal /control, chỉ truy cập trên luồng executor_
+  chrono::milliseconds control_feedback_period_;
+  vector<shared_ptr<ControlGoal>> goals_;
+  // goal chưa có kết quả, tra theo handle cho callback cancel (luồng ROS)
+  mutex live_goals_mutex_;
+  unordered_map<const ControlGoalHandle *, shared_ptr<ControlGoal>> live_goals_;
+  shared_ptr<ControlGoal> script_goal_; // goal của chuỗi đang chạy trên executor_
+  shared_ptr<ControlGoal> brace_goal_;
+  uint64_t feedback_timer_{0};
+
+  // Watchdog, chỉ truy cập trên luồng executor_
+  chrono::milliseconds heartbeat_timeout_;
+  string watchdog_action_;
+  int watchdog_max_rearms_;
+  array<bool, NUM_MOTORS> armed_{};    // đã ra lệnh closed loop, watchdog giữ trạng thái này
+  array<int, NUM_MOTORS> rearm_count_{};
+  array<bool, NUM_MOTORS> hb_lost_{};
 };
 
 // ────────────────────────────────────────────────────────────────
-// main()
+// Component: executable odrive_interface_node do rclcpp_components sinh,
+// hoặc nạp vào container (robot_bringup/launch/robot_container.launch.py)
 // ────────────────────────────────────────────────────────────────
-int main(int argc, char **argv)
-{
-  rclcpp::init(argc, argv);
-  rclcpp::spin(std::make_shared<OdriveInterfaceNode>());
-  rclcpp::shutdown();
-  return 0;
-}
\ No newline at end of file
+RCLCPP_COMPONENTS_REGISTER_NODE(OdriveInterfaceNode)
\ No newline at end of file
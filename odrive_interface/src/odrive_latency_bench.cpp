@@ -0,0 +1,168 @@
+// Đo độ trễ đầu-cuối /control → CAN TX → feedback, chạy cùng odrive_sim_node trên vcan:
+//   ros2 run odrive_interface odrive_sim_node
+//   ros2 run odrive_interface odrive_interface_node --ros-args -p can_interface:=vcan0 -p shooter_max_accel:=0.0
+//   ros2 run odrive_interface odrive_latency_bench --ros-args -p iterations:=1000
+// shooter_max_accel:=0 tắt profile S-curve: mỗi goal gửi đúng một frame SetInputVel.
+// t1 là frame SetInputVel đầu tiên của motor đo sau t0, bất kể giá trị, nên đo độ trễ tới
+// lệnh đầu tiên chứ không phải thời gian tăng tốc. Nếu để profile bật, period_ms phải dài
+// hơn một lần tăng tốc, nếu không frame đầu có thể là của đoạn ramp trước.
+#include <rclcpp/rclcpp.hpp>
+#include <rclcpp_action/rclcpp_action.hpp>
+#include "robot_interfaces/action/control.hpp"
+#include "robot_interfaces/srv/push_ball.hpp"
+#include "odrive_interface/can_comm.hpp"
+#include "odrive_interface/odrive_motor.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <vector>
+using namespace std;
+using namespace chrono_literals;
+using ControlAction = robot_interfaces::action::Control;
+using PushBall = robot_interfaces::srv::PushBall;
+
+static constexpr uint8_t PROBE_NODE_ID = 0; // motor bắn đầu tiên
+static constexpr uint8_t MAX_PROBE_VEL = 50;
+
+class OdriveLatencyBench : public rclcpp::Node
+{
+public:
+  OdriveLatencyBench() : Node("odrive_latency_bench")
+  {
+    auto iface = declare_parameter<string>("can_interface", "vcan0");
+    iterations_ = declare_parameter<int>("iterations", 200);
+    auto period_ms = declare_parameter<int>("period_ms", 50);
+
+    // Socket riêng để nghe bus: thấy cả lệnh của odrive_interface lẫn feedback của sim
+    if (!can_.openInterface(iface))
+      throw runtime_error("Could not open " + iface);
+    can_.registerFeedbackCallback(bind(&OdriveLatencyBench::on_frame, this,
+                                       placeholders::_1, placeholders::_2,
+                                       placeholders::_3, placeholders::_4));
+    can_.startReceiveThread();
+
+    // /push_ball giả để chuỗi bắn không báo lỗi
+    push_ball_srv_ = create_service<PushBall>(
+        "push_ball",
+        [](const shared_ptr<PushBall::Request>, shared_ptr<PushBall::Response> res)
+        { res->success = true; });
+    control_client_ = rclcpp_action::create_client<ControlAction>(this, "control");
+
+    to_tx_.reserve(iterations_);
+    tx_to_fb_.reserve(iterations_);
+    total_.reserve(iterations_);
+    timer_ = create_wall_timer(chrono::milliseconds(period_ms),
+                               bind(&OdriveLatencyBench::tick, this));
+    RCLCPP_INFO(get_logger(), "Benchmarking %d /control calls on %s", iterations_, iface.c_str());
+  }
+
+  ~OdriveLatencyBench() override
+  {
+    can_.stopReceiveThread();
+  }
+
+private:
+  // Luồng RX: chỉ ghi timestamp kernel, không xử lý nặng
+  void on_frame(uint32_t frame_id, const uint8_t *, uint8_t len, uint64_t ts)
+  {
+    if (((frame_id >> 5) & 0x3F) != PROBE_NODE_ID || t0_.load(memory_order_acquire) == 0)
+      return;
+    const uint8_t cmd = frame_id & 0x1F;
+    if (cmd == odrive::SetInputVel::CMD_ID && len >= 4 && t1_.load(memory_order_relaxed) == 0)
+    {
+      t1_.store(ts, memory_order_release);
+    }
+    else if (cmd == OdriveMotor::FEEDBACK_CMD_ID && t1_.load(memory_order_acquire) != 0 &&
+             t2_.load(memory_order_relaxed) == 0)
+    {
+      t2_.store(ts, memory_order_release);
+    }
+  }
+
+  void tick()
+  {
+    // Gom kết quả lần đo trước
+    const uint64_t t0 = t0_.load(memory_order_acquire);
+    if (t0 != 0)
+    {
+      const uint64_t t1 = t1_.load(memory_order_acquire);
+      const uint64_t t2 = t2_.load(memory_order_acquire);
+      if (t1 != 0 && t2 != 0)
+      {
+        to_tx_.push_back(t1 - t0);
+        tx_to_fb_.push_back(t2 - t1);
+        total_.push_back(t2 - t0);
+      }
+      else
+      {
+        ++missed_;
+      }
+      t0_.store(0, memory_order_release);
+    }
+
+    if (sent_ >= iterations_)
+    {
+      report();
+      timer_->cancel();
+      rclcpp::shutdown();
+      return;
+    }
+    if (!control_client_->action_server_is_ready())
+    {
+      RCLCPP_WARN(get_logger(), "Waiting for /control ...");
+      return;
+    }
+
+    // Mỗi lần một vận tốc khác nhau để mỗi goal thật sự đổi setpoint
+    const uint8_t vel = static_cast<uint8_t>(1 + sent_ % MAX_PROBE_VEL);
+    t1_.store(0, memory_order_relaxed);
+    t2_.store(0, memory_order_relaxed);
+    ControlAction::Goal goal;
+    goal.action = 1;
+    goal.velocity = vel;
+    t0_.store(CANTrace::monotonicNs(), memory_order_release);
+    control_client_->async_send_goal(goal);
+    ++sent_;
+  }
+
+  static double percentile_us(vector<uint64_t> v, double q)
+  {
+    if (v.empty())
+      return 0.0;
+    auto nth = v.begin() + static_cast<ptrdiff_t>(q * static_cast<double>(v.size() - 1));
+    nth_element(v.begin(), nth, v.end());
+    return static_cast<double>(*nth) / 1000.0;
+  }
+
+  void report()
+  {
+    auto line = [this](const char *name, const vector<uint64_t> &v)
+    {
+      RCLCPP_INFO(get_logger(), "%-16s p50 %8.1f us  p99 %8.1f us  max %8.1f us",
+                  name, percentile_us(v, 0.5), percentile_us(v, 0.99), percentile_us(v, 1.0));
+    };
+    RCLCPP_INFO(get_logger(), "%zu samples, %d missed", total_.size(), missed_);
+    line("control -> TX", to_tx_);
+    line("TX -> feedback", tx_to_fb_);
+    line("total", total_);
+  }
+
+  CANInterface can_;
+  rclcpp::Service<PushBall>::SharedPtr push_ball_srv_;
+  rclcpp_action::Client<ControlAction>::SharedPtr control_client_;
+  rclcpp::TimerBase::SharedPtr timer_;
+
+  int iterations_;
+  int sent_{0};
+  int missed_{0};
+  atomic<uint64_t> t0_{0}, t1_{0}, t2_{0};
+  vector<uint64_t> to_tx_, tx_to_fb_, total_;
+};
+
+int main(int argc, char **argv)
+{
+  rclcpp::init(argc, argv);
+  rclcpp::spin(std::make_shared<OdriveLatencyBench>());
+  rclcpp::shutdown();
+  return 0;
+}
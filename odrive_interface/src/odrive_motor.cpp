@@ -1,28 +1,40 @@
 #include "odrive_interface/odrive_motor.hpp"
+#include <algorithm>
+#include <cmath>
 #include <cstring>
 #include <iostream>
 
-std::vector<uint8_t> OdriveMotor::floatToBytes(float value)
+namespace
 {
-    std::vector<uint8_t> bytes(sizeof(float));
-    std::memcpy(bytes.data(), &value, sizeof(float));
-    return bytes;
+// No heartbeat / error frame decoded yet
+constexpr uint64_t NO_REPORT = UINT64_MAX;
 }
 
-uint32_t OdriveMotor::computeFrameId(uint8_t cmd_id)
+CANInterface::Frame OdriveMotor::makeFrame(uint8_t cmd_id, std::span<const uint8_t> data) const
 {
-    return (static_cast<uint32_t>(device_id_) << 5) | cmd_id;
+    CANInterface::Frame frame{};
+    frame.can_id = computeFrameId(device_id_, cmd_id);
+    frame.can_dlc = static_cast<uint8_t>(std::min<size_t>(data.size(), CAN_MAX_DLEN));
+    std::memcpy(frame.data, data.data(), frame.can_dlc);
+    return frame;
 }
 
 OdriveMotor::OdriveMotor(uint8_t device_id, ControlMode mode, CANInterface *can_interface)
-    : device_id_(device_id), mode_(mode), can_interface_(can_interface) {}
+    : device_id_(device_id), mode_(mode), can_interface_(can_interface),
+      heartbeat_word_(NO_REPORT), error_word_(NO_REPORT)
+{
+    can_interface_->registerNode(device_id_, this);
+}
 
-OdriveMotor::~OdriveMotor() {}
+OdriveMotor::~OdriveMotor()
+{
+    can_interface_->registerNode(device_id_, nullptr);
+}
 
-bool OdriveMotor::sendCommand(uint8_t cmd_id, const std::vector<uint8_t> &data)
+bool OdriveMotor::sendCommand(uint8_t cmd_id, std::span<const uint8_t> data, CANInterface::TxPriority priority)
 {
-    uint32_t frame_id = computeFrameId(cmd_id);
-    if (!can_interface_->sendFrame(frame_id, data))
+    uint32_t frame_id = computeFrameId(device_id_, cmd_id);
+    if (!can_interface_->sendFrame(frame_id, data, priority))
     {
         std::cerr << "Failed to send cmd_id=0x" << std::hex << static_cast<int>(cmd_id) << std::dec << std::endl;
         return false;
@@ -30,47 +42,209 @@ bool OdriveMotor::sendCommand(uint8_t cmd_id, const std::vector<uint8_t> &data)
     return true;
 }
 
+bool OdriveMotor::sendAxisState(uint32_t state)
+{
+    return send(odrive::SetAxisState{state});
+}
+
 bool OdriveMotor::fullCalibration()
 {
-    return sendCommand(0x07, {0x03});
+    return sendAxisState(AXIS_STATE_FULL_CALIBRATION);
 }
 
 bool OdriveMotor::idle()
 {
-    return sendCommand(0x07, {0x01});
+    return sendAxisState(AXIS_STATE_IDLE);
 }
 
 bool OdriveMotor::closeLoopControl()
 {
-    return sendCommand(0x07, {0x08});
+    return sendAxisState(AXIS_STATE_CLOSED_LOOP);
 }
 
 bool OdriveMotor::clearError()
 {
-    return sendCommand(0x18, {0x00});
+    return send(odrive::ClearErrors{});
 }
 
 bool OdriveMotor::setHoming()
 {
-    return sendCommand(0x07, {0x0B});
+    return sendAxisState(AXIS_STATE_HOMING);
 }
 
-bool OdriveMotor::setTarget(float value)
+CANInterface::Frame OdriveMotor::targetFrame(float value) const
 {
-    uint8_t cmd_id = 0;
     switch (mode_)
     {
     case VELOCITY:
-        cmd_id = 0x0D;
-        break;
+        return makeFrame(odrive::SetInputVel{value});
     case POSITION:
-        cmd_id = 0x0C;
-        break;
+        return makeFrame(odrive::SetInputPos{value});
     case TORQUE:
-        cmd_id = 0x0E;
-        break;
+        return makeFrame(odrive::SetInputTorque{value});
+    }
+    return makeFrame(odrive::SetInputVel{value});
+}
+
+bool OdriveMotor::reachedTarget(float position, float velocity, float target) const
+{
+    const float actual = mode_ == POSITION ? position : velocity;
+    const float tolerance = std::max(LATENCY_ABS_TOLERANCE, LATENCY_REL_TOLERANCE * std::fabs(target));
+    return std::fabs(actual - target) <= tolerance;
+}
+
+void OdriveMotor::onTransmit(uint8_t cmd_id, const uint8_t *data, uint8_t len, uint64_t timestamp_ns)
+{
+    // Only setpoints whose first field is what the encoder reports back
+    const bool tracked = (mode_ == VELOCITY && cmd_id == odrive::SetInputVel::CMD_ID) ||
+                         (mode_ == POSITION && cmd_id == odrive::SetInputPos::CMD_ID);
+    if (!tracked || len < sizeof(float) || pending_cmd_ns_.load(std::memory_order_acquire) != 0)
+        return;
+    float target;
+    std::memcpy(&target, data, sizeof(target));
+    // A streamer re-sending a target the axis already holds is not a step
+    const Feedback fb = getFeedback();
+    if (reachedTarget(fb.position, fb.velocity, target))
+        return;
+    pending_target_.store(target, std::memory_order_relaxed);
+    pending_cmd_ns_.store(timestamp_ns, std::memory_order_release);
+}
+
+bool OdriveMotor::setTarget(float value)
+{
+    switch (mode_)
+    {
+    case POSITION:
+        return setPosition(value);
+    case TORQUE:
+        return setTorque(value);
+    case VELOCITY:
+    default:
+        return setVelocity(value);
+    }
+}
+
+bool OdriveMotor::setVelocity(float velocity, float torque_ff)
+{
+    return sendSetpoint(odrive::SetInputVel{velocity, torque_ff});
+}
+
+bool OdriveMotor::setPosition(float position, float vel_ff, float torque_ff)
+{
+    return sendSetpoint(odrive::SetInputPos{position, vel_ff, torque_ff});
+}
+
+bool OdriveMotor::setTorque(float torque)
+{
+    return sendSetpoint(odrive::SetInputTorque{torque});
+}
+
+bool OdriveMotor::setLimits(float velocity_limit, float current_limit)
+{
+    return send(odrive::SetLimits{velocity_limit, current_limit});
+}
+
+bool OdriveMotor::setControllerMode(odrive::ControlMode control, odrive::InputMode input)
+{
+    return send(odrive::SetControllerMode{control, input});
+}
+
+// Build one frame per motor, batch the frames per bus and flush each bus with
+// one sendFrames() call, so a group spread over several buses costs one
+// syscall per bus regardless of the order of `motors`.
+template <typename BuildFrame>
+bool OdriveMotor::sendGroup(std::span<OdriveMotor *const> motors, BuildFrame build,
+                            CANInterface::TxPriority priority)
+{
+    struct Batch
+    {
+        CANInterface *bus{nullptr};
+        size_t count{0};
+        CANInterface::Frame frames[CANInterface::MAX_BATCH];
+    };
+    std::array<Batch, MAX_GROUP_BUSES> batches;
+    size_t used = 0;
+    bool ok = true;
+
+    auto flush = [&](Batch &b)
+    {
+        if (b.count > 0)
+            ok &= b.bus->sendFrames({b.frames, b.count}, priority);
+        b.count = 0;
+    };
+
+    for (size_t i = 0; i < motors.size(); ++i)
+    {
+        OdriveMotor *motor = motors[i];
+        Batch *batch = nullptr;
+        for (size_t b = 0; b < used; ++b)
+            if (batches[b].bus == motor->can_interface_)
+                batch = &batches[b];
+        if (!batch)
+        {
+            if (used == batches.size())
+            {
+                for (size_t b = 0; b < used; ++b)
+                    flush(batches[b]);
+                used = 0;
+            }
+            batch = &batches[used++];
+            batch->bus = motor->can_interface_;
+            batch->count = 0;
+        }
+        if (batch->count == CANInterface::MAX_BATCH)
+            flush(*batch);
+        batch->frames[batch->count++] = build(*motor, i);
+    }
+    for (size_t b = 0; b < used; ++b)
+        flush(batches[b]);
+    return ok;
+}
+
+bool OdriveMotor::setTargets(std::span<OdriveMotor *const> motors, std::span<const float> values)
+{
+    if (motors.size() != values.size())
+    {
+        std::cerr << "setTargets: " << motors.size() << " motors but "
+                  << values.size() << " values" << std::endl;
+        return false;
+    }
+    return sendGroup(motors, [&](OdriveMotor &m, size_t i)
+                     { return m.targetFrame(values[i]); },
+                     CANInterface::TxPriority::SETPOINT);
+}
+
+bool OdriveMotor::setVelocities(std::span<OdriveMotor *const> motors, std::span<const float> velocities,
+                                std::span<const float> torque_ffs)
+{
+    if (motors.size() != velocities.size() || motors.size() != torque_ffs.size())
+    {
+        std::cerr << "setVelocities: " << motors.size() << " motors but "
+                  << velocities.size() << " velocities and " << torque_ffs.size()
+                  << " feed-forwards" << std::endl;
+        return false;
     }
-    return sendCommand(cmd_id, floatToBytes(value));
+    return sendGroup(motors, [&](OdriveMotor &m, size_t i)
+                     { return m.makeFrame(odrive::SetInputVel{velocities[i], torque_ffs[i]}); },
+                     CANInterface::TxPriority::SETPOINT);
+}
+
+bool OdriveMotor::idleGroup(std::span<OdriveMotor *const> motors)
+{
+    return sendGroup(motors, [](OdriveMotor &m, size_t)
+                     { return m.makeFrame(odrive::SetAxisState{AXIS_STATE_IDLE}); });
+}
+
+bool OdriveMotor::closeLoopControlGroup(std::span<OdriveMotor *const> motors)
+{
+    return sendGroup(motors, [](OdriveMotor &m, size_t)
+                     { return m.makeFrame(odrive::SetAxisState{AXIS_STATE_CLOSED_LOOP}); });
+}
+
+bool OdriveMotor::clearErrorGroup(std::span<OdriveMotor *const> motors)
+{
+    return sendGroup(motors, [](OdriveMotor &m, size_t)
+                     { return m.makeFrame(odrive::ClearErrors{}); });
 }
 
 uint8_t OdriveMotor::getDeviceId() const
@@ -78,18 +252,137 @@ uint8_t OdriveMotor::getDeviceId() const
     return device_id_;
 }
 
-void OdriveMotor::setFeedback(float pos, float vel)
+void OdriveMotor::setFeedback(float pos, float vel, uint64_t timestamp_ns)
 {
-    position_ = pos;
-    velocity_ = vel;
+    const uint32_t seq = fb_seq_.load(std::memory_order_relaxed);
+    fb_seq_.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    position_.store(pos, std::memory_order_relaxed);
+    velocity_.store(vel, std::memory_order_relaxed);
+    fb_timestamp_ns_.store(timestamp_ns, std::memory_order_relaxed);
+    fb_seq_.store(seq + 2, std::memory_order_release);
+
+    if (feedback_listener_)
+        feedback_listener_();
+}
+
+void OdriveMotor::setFeedbackListener(std::function<void()> listener)
+{
+    feedback_listener_ = std::move(listener);
+}
+
+void OdriveMotor::setHealthListener(std::function<void(const Health &)> listener)
+{
+    health_listener_ = std::move(listener);
+}
+
+void OdriveMotor::onFrame(uint8_t cmd_id, const uint8_t *data, uint8_t len, uint64_t timestamp_ns)
+{
+    switch (cmd_id)
+    {
+    case FEEDBACK_CMD_ID:
+    {
+        // Get_Encoder_Estimates: pos (float32) | vel (float32)
+        if (len < 8)
+            return;
+        float pos, vel;
+        std::memcpy(&pos, data, sizeof(float));
+        std::memcpy(&vel, data + 4, sizeof(float));
+        setFeedback(pos, vel, timestamp_ns);
+
+        uint64_t sent = pending_cmd_ns_.load(std::memory_order_acquire);
+        if (sent && timestamp_ns > sent)
+        {
+            const uint64_t elapsed = timestamp_ns - sent;
+            if (elapsed > LATENCY_TIMEOUT_NS)
+                pending_cmd_ns_.compare_exchange_strong(sent, 0, std::memory_order_relaxed);
+            else if (reachedTarget(pos, vel, pending_target_.load(std::memory_order_relaxed)) &&
+                     pending_cmd_ns_.compare_exchange_strong(sent, 0, std::memory_order_relaxed))
+                latency_.record(elapsed);
+        }
+        break;
+    }
+    case HEARTBEAT_CMD_ID:
+    {
+        // Heartbeat: axis_error (u32) | axis_state (u8) | procedure_result (u8) | traj_done (u8, bit 0)
+        if (len < 7)
+            return;
+        uint32_t axis_error;
+        std::memcpy(&axis_error, data, sizeof(axis_error));
+        const uint64_t word = axis_error | (static_cast<uint64_t>(data[4]) << 32) |
+                              (static_cast<uint64_t>(data[5]) << 40) |
+                              (static_cast<uint64_t>(data[6] & 0x01) << 48);
+        heartbeat_ns_.store(timestamp_ns, std::memory_order_relaxed);
+        const uint64_t prev = heartbeat_word_.exchange(word, std::memory_order_acq_rel);
+        // Only state/error transitions wake the listener, not every 10 Hz heartbeat
+        if (prev != word && health_listener_)
+            health_listener_(getHealth());
+        break;
+    }
+    case ERROR_CMD_ID:
+    {
+        // Get_Error: active_errors (u32) | disarm_reason (u32)
+        if (len < 8)
+            return;
+        uint32_t active, disarm;
+        std::memcpy(&active, data, sizeof(active));
+        std::memcpy(&disarm, data + 4, sizeof(disarm));
+        const uint64_t word = active | (static_cast<uint64_t>(disarm) << 32);
+        error_ns_.store(timestamp_ns, std::memory_order_relaxed);
+        const uint64_t prev = error_word_.exchange(word, std::memory_order_acq_rel);
+        if (prev != word && health_listener_)
+            health_listener_(getHealth());
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+OdriveMotor::Health OdriveMotor::getHealth() const
+{
+    Health h{};
+    const uint64_t hb = heartbeat_word_.load(std::memory_order_acquire);
+    if (hb != NO_REPORT)
+    {
+        h.axis_error = static_cast<uint32_t>(hb);
+        h.axis_state = static_cast<uint8_t>(hb >> 32);
+        h.procedure_result = static_cast<uint8_t>(hb >> 40);
+        h.trajectory_done = (hb >> 48) & 0x01;
+        h.heartbeat_ns = heartbeat_ns_.load(std::memory_order_relaxed);
+    }
+    const uint64_t err = error_word_.load(std::memory_order_acquire);
+    if (err != NO_REPORT)
+    {
+        h.active_errors = static_cast<uint32_t>(err);
+        h.disarm_reason = static_cast<uint32_t>(err >> 32);
+        h.error_ns = error_ns_.load(std::memory_order_relaxed);
+    }
+    return h;
+}
+
+OdriveMotor::Feedback OdriveMotor::getFeedback() const
+{
+    Feedback fb;
+    uint32_t before, after;
+    do
+    {
+        before = fb_seq_.load(std::memory_order_acquire);
+        fb.position = position_.load(std::memory_order_relaxed);
+        fb.velocity = velocity_.load(std::memory_order_relaxed);
+        fb.timestamp_ns = fb_timestamp_ns_.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        after = fb_seq_.load(std::memory_order_relaxed);
+    } while ((before & 1u) || before != after);
+    return fb;
 }
 
 float OdriveMotor::getVelocity() const
 {
-    return velocity_;
+    return getFeedback().velocity;
 }
 
 float OdriveMotor::getPosition() const
 {
-    return position_;
+    return getFeedback().position;
 }
@@ -0,0 +1,188 @@
+// Giả lập các node ODrive trên vcan để test odrive_interface không cần phần cứng.
+//   sudo ip link add dev vcan0 type vcan && sudo ip link set up vcan0
+//   ros2 run odrive_interface odrive_sim_node --ros-args -p can_interface:=vcan0
+#include <rclcpp/rclcpp.hpp>
+#include "odrive_interface/can_comm.hpp"
+#include "odrive_interface/odrive_motor.hpp"
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <mutex>
+#include <vector>
+using namespace std;
+using namespace chrono_literals;
+
+// Một trục ODrive: trạng thái axis, setpoint và động học bậc nhất
+class SimulatedOdrive : public CANNodeHandler
+{
+public:
+  static constexpr uint8_t AXIS_STATE_IDLE = 0x01;
+  static constexpr uint8_t AXIS_STATE_CLOSED_LOOP = 0x08;
+
+  explicit SimulatedOdrive(uint8_t node_id) : node_id_(node_id) {}
+
+  // Luồng RX của CANInterface
+  void onFrame(uint8_t cmd_id, const uint8_t *data, uint8_t len, uint64_t) override
+  {
+    lock_guard<mutex> lock(mutex_);
+    switch (cmd_id)
+    {
+    case odrive::SetAxisState::CMD_ID:
+      if (len >= 4)
+      {
+        uint32_t state;
+        memcpy(&state, data, sizeof(uint32_t));
+        axis_state_ = state == AXIS_STATE_CLOSED_LOOP ? AXIS_STATE_CLOSED_LOOP : AXIS_STATE_IDLE;
+      }
+      break;
+    case odrive::SetInputPos::CMD_ID:
+      if (len >= 4)
+      {
+        memcpy(&input_pos_, data, sizeof(float));
+        position_mode_ = true;
+      }
+      break;
+    case odrive::SetInputVel::CMD_ID:
+      if (len >= 4)
+      {
+        memcpy(&input_vel_, data, sizeof(float));
+        position_mode_ = false;
+      }
+      break;
+    case odrive::ClearErrors::CMD_ID:
+      axis_error_ = 0;
+      break;
+    default:
+      break;
+    }
+  }
+
+  // Tích phân một bước dt (s) với hằng số thời gian tau (s)
+  void step(float dt, float tau)
+  {
+    lock_guard<mutex> lock(mutex_);
+    const float k = dt / (tau + dt);
+    if (axis_state_ != AXIS_STATE_CLOSED_LOOP)
+    {
+      vel_ -= vel_ * k; // trôi tự do về 0
+    }
+    else if (position_mode_)
+    {
+      const float new_pos = pos_ + (input_pos_ - pos_) * k;
+      vel_ = (new_pos - pos_) / dt;
+      pos_ = new_pos;
+      return;
+    }
+    else
+    {
+      vel_ += (input_vel_ - vel_) * k;
+    }
+    pos_ += vel_ * dt;
+  }
+
+  CANInterface::Frame encoderFrame()
+  {
+    lock_guard<mutex> lock(mutex_);
+    CANInterface::Frame f{};
+    f.can_id = OdriveMotor::computeFrameId(node_id_, OdriveMotor::FEEDBACK_CMD_ID);
+    f.can_dlc = 8;
+    memcpy(f.data, &pos_, sizeof(float));
+    memcpy(f.data + 4, &vel_, sizeof(float));
+    return f;
+  }
+
+  CANInterface::Frame heartbeatFrame()
+  {
+    lock_guard<mutex> lock(mutex_);
+    CANInterface::Frame f{};
+    f.can_id = OdriveMotor::computeFrameId(node_id_, OdriveMotor::HEARTBEAT_CMD_ID);
+    f.can_dlc = 8;
+    memcpy(f.data, &axis_error_, sizeof(uint32_t));
+    f.data[4] = axis_state_;
+    return f;
+  }
+
+private:
+  uint8_t node_id_;
+  mutex mutex_;
+  uint8_t axis_state_{AXIS_STATE_IDLE};
+  uint32_t axis_error_{0};
+  bool position_mode_{false};
+  float input_vel_{0.0f};
+  float input_pos_{0.0f};
+  float vel_{0.0f};
+  float pos_{0.0f};
+};
+
+class OdriveSimNode : public rclcpp::Node
+{
+public:
+  OdriveSimNode() : Node("odrive_sim")
+  {
+    auto iface = declare_parameter<string>("can_interface", "vcan0");
+    auto ids = declare_parameter<vector<int64_t>>("node_ids", {0, 1, 2, 3, 4, 5});
+    auto sim_rate = declare_parameter<double>("sim_rate_hz", 1000.0);
+    auto fb_rate = declare_parameter<double>("feedback_rate_hz", 100.0);
+    auto hb_rate = declare_parameter<double>("heartbeat_rate_hz", 10.0);
+    tau_ = static_cast<float>(declare_parameter<double>("time_constant_s", 0.05));
+
+    if (!can_.openInterface(iface))
+      throw runtime_error("Could not open " + iface);
+
+    for (auto id : ids)
+    {
+      axes_.push_back(make_unique<SimulatedOdrive>(static_cast<uint8_t>(id)));
+      can_.registerNode(static_cast<uint8_t>(id), axes_.back().get());
+    }
+    can_.startReceiveThread();
+
+    dt_ = static_cast<float>(1.0 / sim_rate);
+    fb_every_ = max<int>(1, static_cast<int>(sim_rate / fb_rate));
+    hb_every_ = max<int>(1, static_cast<int>(sim_rate / hb_rate));
+    timer_ = create_wall_timer(chrono::duration<double>(dt_), bind(&OdriveSimNode::tick, this));
+
+    RCLCPP_INFO(get_logger(), "Simulating %zu ODrive nodes on %s (feedback %.0f Hz)",
+                axes_.size(), iface.c_str(), fb_rate);
+  }
+
+  ~OdriveSimNode() override
+  {
+    can_.stopReceiveThread();
+  }
+
+private:
+  void tick()
+  {
+    for (auto &a : axes_)
+      a->step(dt_, tau_);
+
+    ++ticks_;
+    frames_.clear();
+    if (ticks_ % fb_every_ == 0)
+      for (auto &a : axes_)
+        frames_.push_back(a->encoderFrame());
+    if (ticks_ % hb_every_ == 0)
+      for (auto &a : axes_)
+        frames_.push_back(a->heartbeatFrame());
+    if (!frames_.empty())
+      can_.sendFrames(frames_);
+  }
+
+  CANInterface can_;
+  vector<unique_ptr<SimulatedOdrive>> axes_;
+  vector<CANInterface::Frame> frames_;
+  rclcpp::TimerBase::SharedPtr timer_;
+  float dt_;
+  float tau_;
+  int fb_every_;
+  int hb_every_;
+  uint64_t ticks_{0};
+};
+
+int main(int argc, char **argv)
+{
+  rclcpp::init(argc, argv);
+  rclcpp::spin(std::make_shared<OdriveSimNode>());
+  rclcpp::shutdown();
+  return 0;
+}
@@ -0,0 +1,87 @@
+#include "odrive_interface/rt_thread.hpp"
+#include <cerrno>
+#include <cstring>
+#include <sched.h>
+#include <sys/mman.h>
+
+bool applyRtConfig(pthread_t thread, const RtThreadConfig &cfg, std::string &error)
+{
+    bool ok = true;
+    if (!cfg.cpus.empty())
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int cpu : cfg.cpus)
+            if (cpu >= 0 && cpu < CPU_SETSIZE)
+                CPU_SET(cpu, &set);
+        const int rc = pthread_setaffinity_np(thread, sizeof(set), &set);
+        if (rc != 0)
+        {
+            error += std::string("affinity: ") + std::strerror(rc) + "; ";
+            ok = false;
+        }
+    }
+    if (cfg.priority > 0)
+    {
+        struct sched_param sp{};
+        sp.sched_priority = cfg.priority;
+        const int rc = pthread_setschedparam(thread, SCHED_FIFO, &sp);
+        if (rc != 0)
+        {
+            error += std::string("SCHED_FIFO: ") + std::strerror(rc) + "; ";
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+bool lockMemory(std::string &error)
+{
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0)
+    {
+        error = std::string("mlockall: ") + std::strerror(errno);
+        return false;
+    }
+    return true;
+}
+
+void prefaultStack()
+{
+    [[maybe_unused]] volatile unsigned char stack[PREFAULT_STACK_BYTES];
+    for (size_t i = 0; i < PREFAULT_STACK_BYTES; i += 4096)
+        stack[i] = 0;
+}
+
+std::string describeThread(pthread_t thread)
+{
+    int policy = 0;
+    struct sched_param sp{};
+    std::string out = "?";
+    if (pthread_getschedparam(thread, &policy, &sp) == 0)
+    {
+        switch (policy)
+        {
+        case SCHED_FIFO:
+            out = "SCHED_FIFO/" + std::to_string(sp.sched_priority);
+            break;
+        case SCHED_RR:
+            out = "SCHED_RR/" + std::to_string(sp.sched_priority);
+            break;
+        default:
+            out = "SCHED_OTHER";
+            break;
+        }
+    }
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (pthread_getaffinity_np(thread, sizeof(set), &set) == 0)
+    {
+        std::string cpus;
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+            if (CPU_ISSET(cpu, &set))
+                cpus += (cpus.empty() ? "" : ",") + std::to_string(cpu);
+        out += " cpus=" + cpus;
+    }
+    return out;
+}
@@ -0,0 +1,167 @@
+#include "odrive_interface/trajectory.hpp"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+// Fresh feedback is used as the start point of a new profile
+static constexpr uint64_t START_FEEDBACK_MAX_AGE_NS = 100'000'000;
+// Longest gap integrated in one tick after the executor was held up
+static constexpr int MAX_CATCH_UP_PERIODS = 5;
+
+void SetpointProfile::reset(float value)
+{
+    value_ = value;
+    target_ = value;
+    rate_ = 0.0f;
+}
+
+bool SetpointProfile::step(float dt)
+{
+    const float error = target_ - value_;
+    if (limits_.rate <= 0.0f || dt <= 0.0f)
+    {
+        value_ = target_;
+        rate_ = 0.0f;
+        return true;
+    }
+
+    if (limits_.rate_change <= 0.0f)
+    {
+        // First order: ramp at the rate limit
+        const float max_step = limits_.rate * dt;
+        value_ = std::abs(error) <= max_step ? target_ : value_ + std::copysign(max_step, error);
+        return done();
+    }
+
+    // Second order, bang-bang: the rate moves by at most `rc * dt` per step and
+    // never exceeds what still allows stopping exactly on the target
+    const float rc = limits_.rate_change;
+    const float dr = rc * dt;
+    if (std::abs(error) <= 0.5f * dr * dt && std::abs(rate_) <= dr)
+    {
+        value_ = target_;
+        rate_ = 0.0f;
+        return true;
+    }
+
+    const float dir = error >= 0.0f ? 1.0f : -1.0f;
+    const float rate_toward = rate_ * dir;
+    // Largest next rate r' with r'^2 / (2 rc) <= remaining error after this
+    // (trapezoidal) integration step: r'^2 + dr r' - (2 rc |e| - dr r) <= 0
+    const float disc = dr * dr + 4.0f * (2.0f * rc * std::abs(error) - dr * rate_toward);
+    const float reachable = disc > 0.0f ? 0.5f * (std::sqrt(disc) - dr) : 0.0f;
+    const float wanted = std::min(limits_.rate, std::max(0.0f, reachable));
+    const float next = std::clamp(wanted, rate_toward - dr, rate_toward + dr) * dir;
+
+    value_ += 0.5f * (rate_ + next) * dt;
+    rate_ = next;
+    return false;
+}
+
+TrajectoryStreamer::TrajectoryStreamer(MotionExecutor &executor, std::vector<OdriveMotor *> motors,
+                                       SetpointProfile::Limits limits, double rate_hz)
+    : executor_(executor), motors_(std::move(motors)),
+      profiles_(motors_.size(), SetpointProfile(limits)), out_(motors_.size(), 0.0f),
+      torque_ff_(motors_.size(), 0.0f),
+      unlimited_(limits.rate <= 0.0f),
+      period_(std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / rate_hz)))
+{
+}
+
+void TrajectoryStreamer::setTargets(std::span<const float> targets)
+{
+    if (targets.size() != motors_.size())
+    {
+        std::cerr << "TrajectoryStreamer: " << motors_.size() << " motors but "
+                  << targets.size() << " targets" << std::endl;
+        return;
+    }
+    if (unlimited_)
+    {
+        std::copy(targets.begin(), targets.end(), out_.begin());
+        OdriveMotor::setTargets(motors_, out_);
+        return;
+    }
+
+    if (!running_)
+    {
+        // Start from where the motor is, or from the last streamed setpoint
+        const uint64_t now_ns = CANTrace::monotonicNs();
+        for (size_t i = 0; i < motors_.size(); ++i)
+        {
+            const auto fb = motors_[i]->getFeedback();
+            float start = profiles_[i].value();
+            if (fb.ageNs(now_ns) < START_FEEDBACK_MAX_AGE_NS)
+                start = motors_[i]->getControlMode() == OdriveMotor::POSITION ? fb.position : fb.velocity;
+            profiles_[i].reset(start);
+        }
+    }
+    for (size_t i = 0; i < motors_.size(); ++i)
+        profiles_[i].setTarget(targets[i]);
+
+    if (!running_)
+    {
+        running_ = true;
+        last_tick_ = Clock::now() - period_; // first step covers one nominal period
+        tick(++generation_);
+    }
+}
+
+void TrajectoryStreamer::stop()
+{
+    if (!running_)
+        return;
+    running_ = false;
+    ++generation_;
+    executor_.cancelTimer(timer_);
+    timer_ = 0;
+}
+
+void TrajectoryStreamer::hold()
+{
+    stop();
+    // out_ is the last streamed setpoint, also when the profile is unlimited
+    for (size_t i = 0; i < motors_.size(); ++i)
+        profiles_[i].reset(out_[i]);
+    OdriveMotor::setTargets(motors_, out_);
+}
+
+void TrajectoryStreamer::tick(uint64_t gen)
+{
+    if (gen != generation_ || !running_)
+        return;
+    timer_ = 0;
+
+    const auto now = Clock::now();
+    const auto elapsed = std::min<Clock::duration>(now - last_tick_, period_ * MAX_CATCH_UP_PERIODS);
+    const float dt = std::chrono::duration<float>(elapsed).count();
+    last_tick_ = now;
+
+    bool all_done = true;
+    for (size_t i = 0; i < profiles_.size(); ++i)
+    {
+        all_done &= profiles_[i].step(dt);
+        out_[i] = profiles_[i].value();
+    }
+    sendSetpoints();
+
+    if (all_done)
+    {
+        running_ = false;
+        return;
+    }
+    timer_ = executor_.schedule(period_, [this, gen]()
+                                { tick(gen); });
+}
+
+void TrajectoryStreamer::sendSetpoints()
+{
+    if (torque_ff_gain_ == 0.0f)
+    {
+        OdriveMotor::setTargets(motors_, out_);
+        return;
+    }
+    for (size_t i = 0; i < profiles_.size(); ++i)
+        torque_ff_[i] = torque_ff_gain_ * profiles_[i].rate();
+    OdriveMotor::setVelocities(motors_, out_, torque_ff_);
+}
@@ -0,0 +1,169 @@
+// Setpoint encode/send path must not touch the heap: every operator new made by
+// any thread while `counting` is set is counted and must stay at zero.
+// The CAN socket is one end of a socketpair, so the full encode, coalesce,
+// queue and sendmmsg() path runs without SocketCAN or vcan.
+#include <gtest/gtest.h>
+#include "odrive_interface/can_comm.hpp"
+#include "odrive_interface/odrive_motor.hpp"
+#include <array>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <thread>
+#include <sys/socket.h>
+
+namespace
+{
+std::atomic<size_t> allocations{0};
+std::atomic<bool> counting{false};
+
+// Counts allocations made by every thread (caller and CAN TX thread) inside its scope
+class AllocationCounter
+{
+public:
+    AllocationCounter()
+    {
+        allocations.store(0);
+        counting = true;
+    }
+    ~AllocationCounter() { counting = false; }
+    size_t count() const { return allocations.load(); }
+};
+
+// Frames submitted by sendEverything()
+constexpr uint64_t FRAMES_SUBMITTED = 8;
+} // namespace
+
+void *operator new(size_t size)
+{
+    if (counting.load(std::memory_order_relaxed))
+        allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+// Out of line so GCC does not pair the inlined free() with the builtin new
+__attribute__((noinline)) void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+__attribute__((noinline)) void operator delete(void *p, size_t) noexcept
+{
+    std::free(p);
+}
+
+class OdriveMotorAllocTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        int fds[2];
+        ASSERT_EQ(socketpair(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0, fds), 0);
+        ASSERT_TRUE(can_.attachSocket(fds[0], "socketpair"));
+        peer_ = fds[1];
+    }
+
+    void TearDown() override
+    {
+        can_.stopTransmitThread();
+        if (peer_ >= 0)
+            close(peer_);
+    }
+
+    // Frames that reached the other end of the socketpair
+    size_t drainPeer(CANInterface::Frame *first = nullptr)
+    {
+        CANInterface::Frame f;
+        size_t n = 0;
+        while (recv(peer_, &f, sizeof(f), MSG_DONTWAIT) == static_cast<ssize_t>(sizeof(f)))
+        {
+            if (n++ == 0 && first)
+                *first = f;
+        }
+        return n;
+    }
+
+    void sendEverything()
+    {
+        EXPECT_TRUE(vel_.setTarget(12.5f));
+        EXPECT_TRUE(pos_.setTarget(-0.25f));
+        EXPECT_TRUE(vel_.setVelocity(3.0f, 0.1f));
+        EXPECT_TRUE(OdriveMotor::setTargets(group_, values_));
+        EXPECT_TRUE(OdriveMotor::idleGroup(group_));
+        EXPECT_TRUE(vel_.idle());
+    }
+
+    CANInterface can_;
+    OdriveMotor vel_{1, OdriveMotor::VELOCITY, &can_};
+    OdriveMotor pos_{2, OdriveMotor::POSITION, &can_};
+    std::array<OdriveMotor *, 2> group_{&vel_, &pos_};
+    std::array<float, 2> values_{5.0f, 1.5f};
+    int peer_{-1};
+};
+
+// Without the TX thread frames go straight to sendmmsg() on the caller's thread
+TEST_F(OdriveMotorAllocTest, DirectSendDoesNotAllocate)
+{
+    {
+        AllocationCounter counter;
+        sendEverything();
+        EXPECT_EQ(counter.count(), 0u);
+    }
+    EXPECT_EQ(can_.getStats().tx_frames, FRAMES_SUBMITTED);
+
+    CANInterface::Frame first{};
+    EXPECT_EQ(drainPeer(&first), FRAMES_SUBMITTED);
+    EXPECT_EQ(first.can_id, OdriveMotor::computeFrameId(1, odrive::SetInputVel::CMD_ID));
+    EXPECT_EQ(first.can_dlc, odrive::SetInputVel::DLC);
+}
+
+// With the TX thread the caller only fills the urgent FIFO / setpoint slots
+TEST_F(OdriveMotorAllocTest, QueuedSendDoesNotAllocate)
+{
+    ASSERT_TRUE(can_.startTransmitThread());
+    {
+        AllocationCounter counter;
+        sendEverything();
+        // Stay in the window until the TX thread has written or coalesced every frame
+        auto handled = [this]()
+        {
+            const CANStats st = can_.getStats();
+            return st.tx_frames + st.tx_coalesced;
+        };
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+        while (handled() < FRAMES_SUBMITTED && std::chrono::steady_clock::now() < deadline)
+            std::this_thread::yield();
+        EXPECT_EQ(handled(), FRAMES_SUBMITTED);
+        EXPECT_EQ(counter.count(), 0u);
+    }
+    can_.stopTransmitThread();
+    EXPECT_EQ(drainPeer(), can_.getStats().tx_frames);
+}
+
+// RX side: decoding feedback, heartbeat and error frames needs no socket
+TEST(OdriveMotorRxAllocTest, FrameDecodeDoesNotAllocate)
+{
+    CANInterface can;
+    OdriveMotor motor(3, OdriveMotor::VELOCITY, &can);
+
+    const float estimates[2] = {1.0f, 2.0f};
+    uint8_t feedback[8];
+    std::memcpy(feedback, estimates, sizeof(feedback));
+    const uint8_t heartbeat[8] = {0, 0, 0, 0, OdriveMotor::AXIS_STATE_CLOSED_LOOP, 0, 1, 0};
+    const uint8_t error[8] = {};
+
+    AllocationCounter counter;
+    motor.onFrame(OdriveMotor::FEEDBACK_CMD_ID, feedback, 8, 1000);
+    motor.onFrame(OdriveMotor::HEARTBEAT_CMD_ID, heartbeat, 8, 2000);
+    motor.onFrame(OdriveMotor::ERROR_CMD_ID, error, 8, 3000);
+    const OdriveMotor::Feedback fb = motor.getFeedback();
+    const OdriveMotor::Health health = motor.getHealth();
+    EXPECT_EQ(counter.count(), 0u);
+
+    EXPECT_FLOAT_EQ(fb.position, 1.0f);
+    EXPECT_FLOAT_EQ(fb.velocity, 2.0f);
+    EXPECT_EQ(fb.timestamp_ns, 1000u);
+    EXPECT_TRUE(health.closedLoop());
+}
@@ -0,0 +1,54 @@
+# odrive_interface, uart_node và gamepad_node trong một process (component_container_mt).
+# Với use_intra_process_comms, /base_cmd từ gamepad tới uart_node được chuyển bằng con trỏ,
+# không serialize qua DDS. Các node Python (complete_robot.launch.py) vẫn nói chuyện qua DDS.
+#   ros2 launch robot_bringup robot_container.launch.py
+#   ros2 launch robot_bringup robot_container.launch.py intra_process:=false   # để so sánh
+from launch import LaunchDescription
+from launch.actions import DeclareLaunchArgument
+from launch.substitutions import LaunchConfiguration
+from launch_ros.actions import ComposableNodeContainer
+from launch_ros.descriptions import ComposableNode
+
+
+def generate_launch_description():
+    intra_process = LaunchConfiguration('intra_process')
+    extra_args = [{'use_intra_process_comms': intra_process}]
+
+    return LaunchDescription([
+        DeclareLaunchArgument('intra_process', default_value='true',
+                              description='Bật intra-process comms giữa các component'),
+        DeclareLaunchArgument('uart_device', default_value='/dev/ttyUSB0'),
+        DeclareLaunchArgument('can_interface', default_value='can0'),
+
+        ComposableNodeContainer(
+            name='robot_container',
+            namespace='',
+            package='rclcpp_components',
+            # mỗi node một callback group mặc định: callback của cùng node vẫn tuần tự,
+            # node này không chặn node kia
+            executable='component_container_mt',
+            output='screen',
+            composable_node_descriptions=[
+                ComposableNode(
+                    package='odrive_interface',
+                    plugin='OdriveInterfaceNode',
+                    name='odrive_interface',
+                    parameters=[{'can_interface': LaunchConfiguration('can_interface')}],
+                    extra_arguments=extra_args,
+                ),
+                ComposableNode(
+                    package='mcu_interface',
+                    plugin='UARTNode',
+                    name='uart_node',
+                    parameters=[{'uart_device': LaunchConfiguration('uart_device')}],
+                    extra_arguments=extra_args,
+                ),
+                ComposableNode(
+                    package='gamepad_interface',
+                    plugin='GamepadNode',
+                    name='gamepad_node',
+                    extra_arguments=extra_args,
+                ),
+            ],
+        ),
+    ])
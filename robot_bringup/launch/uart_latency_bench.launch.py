@@ -0,0 +1,86 @@
+# So sánh độ trễ /base_cmd -> UART: cùng container (intra-process) và hai process qua DDS.
+# uart_latency_bench thay gamepad_node làm publisher và đọc frame UART qua pty.
+#   ros2 launch robot_bringup uart_latency_bench.launch.py intra_process:=true
+#   ros2 launch robot_bringup uart_latency_bench.launch.py intra_process:=false
+from launch import LaunchDescription
+from launch.actions import DeclareLaunchArgument, EmitEvent, RegisterEventHandler, TimerAction
+from launch.conditions import IfCondition, UnlessCondition
+from launch.event_handlers import OnProcessIO
+from launch.events import Shutdown
+from launch.substitutions import LaunchConfiguration
+from launch_ros.actions import ComposableNodeContainer, Node
+from launch_ros.descriptions import ComposableNode
+
+TTY_LINK = '/tmp/uart_bench_tty'
+# UartLatencyBench::DONE_MARKER, log sau khi in kết quả
+DONE_MARKER = 'UART latency benchmark done'
+
+
+def _shutdown_when_done(event):
+    if DONE_MARKER in event.text.decode(errors='ignore'):
+        return [EmitEvent(event=Shutdown(reason='UART latency benchmark finished'))]
+    return None
+
+
+def generate_launch_description():
+    intra_process = LaunchConfiguration('intra_process')
+    bench_params = [{'tty_link': TTY_LINK,
+                     'iterations': LaunchConfiguration('iterations'),
+                     'period_ms': LaunchConfiguration('period_ms')}]
+    uart_params = [{'uart_device': TTY_LINK}]
+
+    return LaunchDescription([
+        DeclareLaunchArgument('intra_process', default_value='true'),
+        DeclareLaunchArgument('iterations', default_value='500'),
+        DeclareLaunchArgument('period_ms', default_value='20'),
+
+        # Bench không tự shutdown (sẽ kéo theo cả container); dừng lần chạy khi thấy dòng kết thúc
+        RegisterEventHandler(OnProcessIO(on_stdout=_shutdown_when_done, on_stderr=_shutdown_when_done)),
+
+        # Một process: bench nạp trước để pty có sẵn khi uart_node mở
+        ComposableNodeContainer(
+            condition=IfCondition(intra_process),
+            name='bench_container',
+            namespace='',
+            package='rclcpp_components',
+            executable='component_container_mt',
+            output='screen',
+            composable_node_descriptions=[
+                ComposableNode(
+                    package='mcu_interface',
+                    plugin='UartLatencyBench',
+                    name='uart_latency_bench',
+                    parameters=bench_params,
+                    extra_arguments=[{'use_intra_process_comms': True}],
+                ),
+                ComposableNode(
+                    package='mcu_interface',
+                    plugin='UARTNode',
+                    name='uart_node',
+                    parameters=uart_params,
+                    extra_arguments=[{'use_intra_process_comms': True}],
+                ),
+            ],
+        ),
+
+        # Hai process: uart_node khởi động sau 1 s, khi pty của bench đã có
+        Node(
+            condition=UnlessCondition(intra_process),
+            package='mcu_interface',
+            executable='uart_latency_bench',
+            name='uart_latency_bench',
+            parameters=bench_params,
+            output='screen',
+        ),
+        TimerAction(
+            condition=UnlessCondition(intra_process),
+            period=1.0,
+            actions=[Node(
+                package='mcu_interface',
+                executable='uart_node',
+                name='uart_node',
+                parameters=uart_params,
+                output='screen',
+            )],
+        ),
+    ])